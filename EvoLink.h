@@ -75,7 +75,9 @@
  *			EVO.systemDisarm();
  *			EVO.unlock(); // actually unlock the doors! :)
  *
- *			delay(400); // leave the lights on a bit...
+ *			// leave the lights on a bit... commands are queued and
+ *			// sent during checkActivity(), so don't just delay()
+ *			EVO.delayWhileCheckingActivity(400);
  *
  *			EVO.parklightOff();
  *		}
@@ -92,6 +94,10 @@
 
 #include "includes/dependencies.h"
 #include "includes/driver.h"
+#include "includes/poller.h"
+#include "includes/reactor/epoll_reactor.h"
+#include "includes/capture/session_capture.h"
+#include "includes/sim/simulator.h"
 
 
 
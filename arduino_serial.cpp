@@ -33,34 +33,236 @@
 
 namespace EvoLink {
 
-HardwareSerial * _serialconn_usart = NULL;
+static uint8_t frame_bits(uint8_t config)
+{
+#ifdef __AVR__
+	// the SERIAL_xxx config byte is really the UCSRnC setting:
+	// start bit + 5-8 data bits + optional parity + 1-2 stop bits
+	uint8_t bits = 1 + 5 + ((config >> 1) & 0x03);
+	if (config & 0x30)
+		bits++; // parity
+	bits += (config & 0x08) ? 2 : 1;
+	return bits;
+#else
+	// other cores encode this differently, assume 8N1
+	return 10;
+#endif
+}
+
+#ifdef EVOLINK_RX_RING_ENABLE
+/*
+ * RX ring: we drive USART EVOLINK_RX_RING_USART directly, and its RX
+ * interrupt fills usart_rx_ring, which the SerialConnection reads from.
+ */
+#if (EVOLINK_RX_RING_USART == 0 && !defined(UCSR0A)) || \
+	(EVOLINK_RX_RING_USART == 1 && !defined(UCSR1A)) || \
+	(EVOLINK_RX_RING_USART == 2 && !defined(UCSR2A)) || \
+	(EVOLINK_RX_RING_USART == 3 && !defined(UCSR3A)) || \
+	EVOLINK_RX_RING_USART > 3
+#error "this part has no USART EVOLINK_RX_RING_USART (an Uno only has USART 0): set it in config.h"
+#endif
+
+#define EVOLINK_USART_REG_(prefix, n, suffix)	prefix ## n ## suffix
+#define EVOLINK_USART_REG_N(prefix, n, suffix)	EVOLINK_USART_REG_(prefix, n, suffix)
+#define EVOLINK_USART_REG(prefix, suffix)		EVOLINK_USART_REG_N(prefix, EVOLINK_RX_RING_USART, suffix)
+
+#define EVOLINK_UDR		EVOLINK_USART_REG(UDR, )
+#define EVOLINK_UCSRA	EVOLINK_USART_REG(UCSR, A)
+#define EVOLINK_UCSRB	EVOLINK_USART_REG(UCSR, B)
+#define EVOLINK_UCSRC	EVOLINK_USART_REG(UCSR, C)
+#define EVOLINK_UBRR	EVOLINK_USART_REG(UBRR, )
+#define EVOLINK_U2X		EVOLINK_USART_REG(U2X, )
+#define EVOLINK_UDRE	EVOLINK_USART_REG(UDRE, )
+#define EVOLINK_RXEN	EVOLINK_USART_REG(RXEN, )
+#define EVOLINK_TXEN	EVOLINK_USART_REG(TXEN, )
+#define EVOLINK_RXCIE	EVOLINK_USART_REG(RXCIE, )
+#define EVOLINK_DOR		EVOLINK_USART_REG(DOR, )
+
+// single-USART chips (e.g. the Uno's 328P) name the vector differently
+#if EVOLINK_RX_RING_USART == 0 && defined(USART_RX_vect)
+#define EVOLINK_USART_RX_VECT	USART_RX_vect
+#else
+#define EVOLINK_USART_RX_VECT	EVOLINK_USART_REG(USART, _RX_vect)
+#endif
+
+static RxRing<EVOLINK_RX_RING_SIZE> usart_rx_ring;
+
+} /* namespace EvoLink */
+
+ISR(EVOLINK_USART_RX_VECT)
+{
+	// status must be read before the data register
+	if (EVOLINK_UCSRA & _BV(EVOLINK_DOR))
+		EvoLink::usart_rx_ring.noteOverrun(); // hardware buffer overran, too
+
+	EvoLink::usart_rx_ring.push(EVOLINK_UDR);
+}
+
+namespace EvoLink {
+
+bool SerialConnection::setup(SerialSetup & params)
+{
+	if (params.do_begin && ! params.baud_rate)
+		return false; // nothing to set the USART to
+
+	// params.usart is only kept as a handle: it mustn't be used for I/O
+	port = params.usart;
+	if (params.baud_rate)
+		char_time_us = ((1000000UL * frame_bits(params.config)) + params.baud_rate - 1) / params.baud_rate;
+
+	if (params.do_begin)
+	{
+		// double speed, as HardwareSerial::begin() does
+		EVOLINK_UCSRA = _BV(EVOLINK_U2X);
+		EVOLINK_UBRR = (((F_CPU / 4) / params.baud_rate) - 1) / 2;
+		EVOLINK_UCSRC = params.config;
+	}
+
+	EVOLINK_UCSRB |= _BV(EVOLINK_RXEN) | _BV(EVOLINK_TXEN) | _BV(EVOLINK_RXCIE);
+	owns_port = true; // the USART is ours, either way
+	return true;
+}
+
+void SerialConnection::end()
+{
+	if (owns_port)
+		EVOLINK_UCSRB &= ~(_BV(EVOLINK_RXEN) | _BV(EVOLINK_TXEN) | _BV(EVOLINK_RXCIE));
+
+	port = EVOLINK_SERIALPORT_NONE;
+	owns_port = false;
+}
+
+size_t SerialConnection::write(uint8_t c)
+{
+	while (! (EVOLINK_UCSRA & _BV(EVOLINK_UDRE)))
+		;
+	EVOLINK_UDR = c;
+	return 1;
+}
+
+int SerialConnection::available()
+{
+	return usart_rx_ring.available();
+}
+
+int SerialConnection::read()
+{
+	return usart_rx_ring.read();
+}
+
+size_t SerialConnection::readBytes(uint8_t * buf, size_t max)
+{
+	return usart_rx_ring.readBytes(buf, max);
+}
+
+bool SerialConnection::waitForData(uint32_t timeoutUs)
+{
+	uint32_t startTime = micros();
+	while (! usart_rx_ring.available())
+	{
+		if ((micros() - startTime) >= timeoutUs)
+			return false;
+	}
+
+	return true;
+}
+
+uint16_t SerialConnection::rxOverruns()
+{
+	return usart_rx_ring.overruns();
+}
+
+#else
 
-void SerialConnection::setup(SerialSetup & params)
+// HardwareSerial drops incoming bytes when its buffer is full, so finding
+// it full is as close as we get to knowing some were lost.
+#ifdef SERIAL_RX_BUFFER_SIZE
+#define EVOLINK_HWSERIAL_RX_BUFFER_SIZE		SERIAL_RX_BUFFER_SIZE
+#else
+#define EVOLINK_HWSERIAL_RX_BUFFER_SIZE		64
+#endif
+
+bool SerialConnection::setup(SerialSetup & params)
 {
-	_serialconn_usart = params.usart;
+	if (params.do_begin && ! params.baud_rate)
+		return false;
+
+	port = params.usart;
+	if (params.baud_rate)
+		char_time_us = ((1000000UL * frame_bits(params.config)) + params.baud_rate - 1) / params.baud_rate;
 
 	if (params.do_begin)
 	{
-		_serialconn_usart->begin(params.baud_rate, params.config);
+		port->begin(params.baud_rate, params.config);
+		owns_port = true;
 	}
+
+	return (port != NULL);
+}
+
+void SerialConnection::end()
+{
+	if (owns_port && port)
+		port->end();
+
+	port = EVOLINK_SERIALPORT_NONE;
+	owns_port = false;
 }
 
 size_t SerialConnection::write(uint8_t c)
 {
-	return _serialconn_usart->write(c);
+	return port->write(c);
 
 }
 
 int SerialConnection::available()
 {
-	return _serialconn_usart->available();
+	return port->available();
 }
 
 int SerialConnection::read()
 {
-	return _serialconn_usart->read();
+	return port->read();
+}
+
+size_t SerialConnection::readBytes(uint8_t * buf, size_t max)
+{
+	// Stream::readBytes() would block until timeout if we asked for
+	// more than is there, so only take what's available.
+	size_t num = port->available();
+	if (num >= EVOLINK_HWSERIAL_RX_BUFFER_SIZE - 1)
+		rx_overruns++;
+
+	if (num > max)
+		num = max;
+
+	for (size_t i=0; i < num; i++)
+	{
+		buf[i] = (uint8_t)port->read();
+	}
+
+	return num;
+}
+
+bool SerialConnection::waitForData(uint32_t timeoutUs)
+{
+	uint32_t startTime = micros();
+	while (! port->available())
+	{
+		if ((micros() - startTime) >= timeoutUs)
+			return false;
+	}
+
+	return true;
+}
+
+uint16_t SerialConnection::rxOverruns()
+{
+	return (uint16_t)rx_overruns;
 }
 
+#endif /* EVOLINK_RX_RING_ENABLE */
+
 } /* namespace EvoLink */
 
 
@@ -30,64 +30,16 @@
 
 #include "includes/driver.h"
 #include "includes/platform.h"
+#include "includes/capture/session_capture.h"
 
 /*
- * Event dispatchers
+ * Response data processors
  *
- * These dispatchers are used internally to trigger appropriate callbacks
- * for various event (message) codes received.
+ * These massage the raw byte returned for some data requests into
+ * the actual value reported.
  *
  */
-void dispatch_event_remstart(EvoLink::DataLink::MessageCode message)
-{
-	if (EVO.callbacks.remotestarter_event)
-		EVO.callbacks.remotestarter_event((EvoLink::RemoteStarter::Event)message);
-
-}
-
-void dispatch_event_openclose(EvoLink::DataLink::MessageCode message)
-{
-	if (EVO.callbacks.openclose_event)
-		EVO.callbacks.openclose_event((EvoLink::OpenClose::Event)message);
-
-}
-
-void dispatch_event_brake(EvoLink::DataLink::MessageCode message)
-{
-	if (EVO.callbacks.brake_event)
-		EVO.callbacks.brake_event((EvoLink::Brake::Event)message);
-
-}
-void dispatch_event_tach(EvoLink::DataLink::MessageCode message)
-{
-	if (EVO.callbacks.tach_event)
-		EVO.callbacks.tach_event((EvoLink::Tach::Event)message);
-
-}
-
-void dispatch_event_sensor(EvoLink::DataLink::MessageCode message)
-{
-	if (EVO.callbacks.sensor_event)
-		EVO.callbacks.sensor_event((EvoLink::Sensor::Event)message);
-
-}
-
-void dispatch_generic_message(EvoLink::DataLink::MessageCode message)
-{
-	if (EVO.callbacks.message_received)
-		EVO.callbacks.message_received(message);
-
-}
-
-void dispatch_error_message(EvoLink::DataLink::MessageCode message)
-{
-	if (EVO.callbacks.error_event)
-		EVO.callbacks.error_event((EvoLink::ErrorMessage::Event)message, 0);
-
-}
-
-
-int request_response_temperature(EvoLink::DataLink::RequestCode request, uint8_t returnedValue)
+static int request_response_temperature(EvoLink::DataLink::RequestCode request, uint8_t returnedValue)
 {
 	int realVal = returnedValue;
 	realVal -= 168;
@@ -96,133 +48,322 @@ int request_response_temperature(EvoLink::DataLink::RequestCode request, uint8_t
 }
 
 
-int request_response_tach(EvoLink::DataLink::RequestCode request, uint8_t returnedValue)
+static int request_response_tach(EvoLink::DataLink::RequestCode request, uint8_t returnedValue)
 {
 	int realVal = (returnedValue << 8);
 
 	return realVal;
 }
 
+// constant-initialized, so safe to use from other static constructors
+EvoLink::RealClock EvoLink::SystemClock;
 
-void synchronous_getter_handler(EvoLink::DataLink::RequestCode request,
-		int value)
-{
-	// store the received value
-	EVO.synch_getter_value_received = value;
-}
-
+#ifndef EVOLINK_NO_DEFAULT_INSTANCE
 EvoLink::EvoAll EVO;
+#endif
+
+// statistics bookkeeping, gone entirely unless EVOLINK_STATISTICS_ENABLE
+#ifdef EVOLINK_STATISTICS_ENABLE
+#define EVOLINK_STAT(stmt)		stmt
+#else
+#define EVOLINK_STAT(stmt)
+#endif
+
+// likewise, for the trace ring
+#ifdef EVOLINK_TRACE_ENABLE
+#define EVOLINK_TRACE(decision, data)	trace((decision), (data))
+#else
+#define EVOLINK_TRACE(decision, data)
+#endif
 
 namespace EvoLink {
 
 /*
- * Callback association table for supported incoming message types.
+ * Code tables
+ *
+ * Family association table for supported incoming message types, and
+ * the list of requests that get a data response.  These are shared by all
+ * EvoAll instances -- each instance's custom_handlers[] refer to
+ * message_families[] by index.
+ *
+ * Everything here is constexpr, so the 256-entry lookup tables below
+ * (raw code -> index in these lists) are generated by the compiler and
+ * live in flash on AVR: dispatching a received byte is a single lookup.
  */
-EvoAll::MessageCodeCallback EvoAll::callback_assocs[] = {
+#define EVOLINK_NO_TABLE_ENTRY				0xff
+#define EVOLINK_NUM_REQUESTS_WITH_RESPONSE	4
+#define EVOLINK_OUTPUT_ON					0x80
+
+struct EvoAll::DispatchTables {
+
+	static constexpr MessageCodeFamily message_families[EVOLINK_NUM_SUPPORTED_MESSAGES] = {
 
 		// brake events
-		EvoAll::MessageCodeCallback(DataLink::Brake_On, dispatch_event_brake),
-		EvoAll::MessageCodeCallback(DataLink::Brake_Off, dispatch_event_brake),
-		EvoAll::MessageCodeCallback(DataLink::HandBrake_On, dispatch_event_brake),
-		EvoAll::MessageCodeCallback(DataLink::HandBrake_Off, dispatch_event_brake),
+		{DataLink::Brake_On, EvoAll::Family_Brake},
+		{DataLink::Brake_Off, EvoAll::Family_Brake},
+		{DataLink::HandBrake_On, EvoAll::Family_Brake},
+		{DataLink::HandBrake_Off, EvoAll::Family_Brake},
 
 		// tach events
-		EvoAll::MessageCodeCallback(DataLink::Tach_On, dispatch_event_tach),
-		EvoAll::MessageCodeCallback(DataLink::Tach_Off, dispatch_event_tach),
-		EvoAll::MessageCodeCallback(DataLink::Tach_OverRev, dispatch_event_tach),
+		{DataLink::Tach_On, EvoAll::Family_Tach},
+		{DataLink::Tach_Off, EvoAll::Family_Tach},
+		{DataLink::Tach_OverRev, EvoAll::Family_Tach},
 
 		// remote starter events
-		EvoAll::MessageCodeCallback(DataLink::RemoteStarter_Disarm, dispatch_event_remstart),
-		EvoAll::MessageCodeCallback(DataLink::RemoteStarter_Arm, dispatch_event_remstart),
-		EvoAll::MessageCodeCallback(DataLink::RemoteStarter_On, dispatch_event_remstart),
-		EvoAll::MessageCodeCallback(DataLink::RemoteStarter_Off, dispatch_event_remstart),
-		EvoAll::MessageCodeCallback(DataLink::RemoteStarter_UnlockDisarm, dispatch_event_remstart),
-		EvoAll::MessageCodeCallback(DataLink::RemoteStarter_LockArm, dispatch_event_remstart),
+		{DataLink::RemoteStarter_Disarm, EvoAll::Family_RemoteStarter},
+		{DataLink::RemoteStarter_Arm, EvoAll::Family_RemoteStarter},
+		{DataLink::RemoteStarter_On, EvoAll::Family_RemoteStarter},
+		{DataLink::RemoteStarter_Off, EvoAll::Family_RemoteStarter},
+		{DataLink::RemoteStarter_UnlockDisarm, EvoAll::Family_RemoteStarter},
+		{DataLink::RemoteStarter_LockArm, EvoAll::Family_RemoteStarter},
 
 		// open-close events
-		EvoAll::MessageCodeCallback(DataLink::Door_Opened, dispatch_event_openclose),
-		EvoAll::MessageCodeCallback(DataLink::Door_Closed, dispatch_event_openclose),
-		EvoAll::MessageCodeCallback(DataLink::Hood_Opened, dispatch_event_openclose),
-		EvoAll::MessageCodeCallback(DataLink::Hood_Closed, dispatch_event_openclose),
-		EvoAll::MessageCodeCallback(DataLink::Trunk_Opened, dispatch_event_openclose),
-		EvoAll::MessageCodeCallback(DataLink::Trunk_Closed, dispatch_event_openclose),
+		{DataLink::Door_Opened, EvoAll::Family_OpenClose},
+		{DataLink::Door_Closed, EvoAll::Family_OpenClose},
+		{DataLink::Hood_Opened, EvoAll::Family_OpenClose},
+		{DataLink::Hood_Closed, EvoAll::Family_OpenClose},
+		{DataLink::Trunk_Opened, EvoAll::Family_OpenClose},
+		{DataLink::Trunk_Closed, EvoAll::Family_OpenClose},
 
 		// sensor events
-		EvoAll::MessageCodeCallback(DataLink::ShockSensor_Trigger, dispatch_event_sensor),
-		EvoAll::MessageCodeCallback(DataLink::AlarmSensor_PreWarn, dispatch_event_sensor),
-		EvoAll::MessageCodeCallback(DataLink::TiltSensor_Trigger, dispatch_event_sensor),
-		EvoAll::MessageCodeCallback(DataLink::VSS_Over_15MPH, dispatch_event_sensor),
+		{DataLink::ShockSensor_Trigger, EvoAll::Family_Sensor},
+		{DataLink::AlarmSensor_PreWarn, EvoAll::Family_Sensor},
+		{DataLink::TiltSensor_Trigger, EvoAll::Family_Sensor},
+		{DataLink::VSS_Over_15MPH, EvoAll::Family_Sensor},
 
 
 		// generic events
-		EvoAll::MessageCodeCallback(DataLink::Ping_Message, dispatch_generic_message),
-		EvoAll::MessageCodeCallback(DataLink::Pong_Message, dispatch_generic_message),
-		EvoAll::MessageCodeCallback(DataLink::CarKey_In_On, dispatch_generic_message),
-		EvoAll::MessageCodeCallback(DataLink::CarKey_In_Off, dispatch_generic_message),
-		EvoAll::MessageCodeCallback(DataLink::RemoteProgramming_Enable, dispatch_generic_message),
-		EvoAll::MessageCodeCallback(DataLink::RemoteProgramming_Disable, dispatch_generic_message),
+		{DataLink::Ping_Message, EvoAll::Family_Generic},
+		{DataLink::Pong_Message, EvoAll::Family_Generic},
+		{DataLink::CarKey_In_On, EvoAll::Family_Generic},
+		{DataLink::CarKey_In_Off, EvoAll::Family_Generic},
+		{DataLink::RemoteProgramming_Enable, EvoAll::Family_Generic},
+		{DataLink::RemoteProgramming_Disable, EvoAll::Family_Generic},
 
 		// error events
+		{DataLink::Temperature_Error, EvoAll::Family_Error},
 
-		// WARNING: code below expects DataLink::Temperature_Error to be the
-		// LAST VALUE in this list--leave as array terminator, or adapt code as required
-		EvoAll::MessageCodeCallback(DataLink::Temperature_Error, dispatch_error_message),
+	};
 
-};
+	// on/off request pairs driving a single output
+	static constexpr OutputPair output_pairs[EVOLINK_NUM_OUTPUT_PAIRS] = {
+		{DataLink::GroundOut_On, DataLink::GroundOut_Off},
+		{DataLink::Panic_On, DataLink::Panic_Off},
+		{DataLink::ParkingLight_On, DataLink::ParkingLight_Off},
+		{DataLink::Alarm_On, DataLink::Alarm_Off},
+		{DataLink::Accessory_On, DataLink::Accessory_Off},
+		{DataLink::Ignition_FromRemote_On, DataLink::Ignition_FromRemote_Off},
+		{DataLink::Starter_FromRemote_On, DataLink::Starter_FromRemote_Off},
+		{DataLink::Ignition_FromKey_On, DataLink::Ignition_FromKey_Off},
+		{DataLink::Starter_FromKey_On, DataLink::Starter_FromKey_Off},
+		{DataLink::StarterKill_On, DataLink::StarterKill_Off},
+		{DataLink::Horn_On, DataLink::Horn_Off}
+	};
+
+	static constexpr RequestWithResponse reqs_with_responses[EVOLINK_NUM_REQUESTS_WITH_RESPONSE] = {
+		{DataLink::Request_VSS, NULL},
+		{DataLink::Request_Tach, request_response_tach},
+		{DataLink::Request_Input, NULL},
+		{DataLink::Request_Temperature, request_response_temperature}
+
+	};
+
+	// compile-time searches, used to fill the lookup tables
+	static constexpr uint8_t messageIndex(uint8_t code, uint8_t i=0) {
+		return (i >= EVOLINK_NUM_SUPPORTED_MESSAGES) ? EVOLINK_NO_TABLE_ENTRY :
+				(message_families[i].raw_msg_code == code) ? i : messageIndex(code, i + 1);
+	}
+
+	static constexpr uint8_t requestIndex(uint8_t code, uint8_t i=0) {
+		return (i >= EVOLINK_NUM_REQUESTS_WITH_RESPONSE) ? EVOLINK_NO_TABLE_ENTRY :
+				(reqs_with_responses[i].req == code) ? i : requestIndex(code, i + 1);
+	}
+
+	// index in output_pairs[], with EVOLINK_OUTPUT_ON set for the "on" half
+	static constexpr uint8_t outputEntry(uint8_t code, uint8_t i=0) {
+		return (i >= EVOLINK_NUM_OUTPUT_PAIRS) ? EVOLINK_NO_TABLE_ENTRY :
+				(output_pairs[i].on == code) ? (i | EVOLINK_OUTPUT_ON) :
+				(output_pairs[i].off == code) ? i : outputEntry(code, i + 1);
+	}
+
+	// every entry must be reachable through the lookup, i.e. no duplicates
+	static constexpr bool messagesUnique(uint8_t i=0) {
+		return (i >= EVOLINK_NUM_SUPPORTED_MESSAGES) ? true :
+				(messageIndex(message_families[i].raw_msg_code) == i) && messagesUnique(i + 1);
+	}
+
+	static constexpr bool requestsUnique(uint8_t i=0) {
+		return (i >= EVOLINK_NUM_REQUESTS_WITH_RESPONSE) ? true :
+				(requestIndex(reqs_with_responses[i].req) == i) && requestsUnique(i + 1);
+	}
+
+	static constexpr bool outputsUnique(uint8_t i=0) {
+		return (i >= EVOLINK_NUM_OUTPUT_PAIRS) ? true :
+				(outputEntry(output_pairs[i].on) == (i | EVOLINK_OUTPUT_ON)) &&
+				(outputEntry(output_pairs[i].off) == i) && outputsUnique(i + 1);
+	}
 
+	static const uint8_t message_index[256];
+	static const uint8_t request_index[256];
+#ifdef EVOLINK_COMMAND_SUPPRESSION_ENABLE
+	static const uint8_t output_index[256];
+#endif
+};
 
-EvoAll::RequestWithResponse EvoAll::reqs_with_responses[] = {
-		EvoAll::RequestWithResponse(DataLink::Request_VSS),
-		EvoAll::RequestWithResponse(DataLink::Request_Tach, request_response_tach),
-		EvoAll::RequestWithResponse(DataLink::Request_Input),
+constexpr EvoAll::MessageCodeFamily EvoAll::DispatchTables::message_families[];
+constexpr EvoAll::RequestWithResponse EvoAll::DispatchTables::reqs_with_responses[];
+constexpr EvoAll::OutputPair EvoAll::DispatchTables::output_pairs[];
+
+// expand f(code) for every code 0-255
+#define EVOLINK_TABLE_4(f, c)	f(c), f(c + 1), f(c + 2), f(c + 3)
+#define EVOLINK_TABLE_16(f, c)	EVOLINK_TABLE_4(f, c), EVOLINK_TABLE_4(f, c + 4), \
+								EVOLINK_TABLE_4(f, c + 8), EVOLINK_TABLE_4(f, c + 12)
+#define EVOLINK_TABLE_64(f, c)	EVOLINK_TABLE_16(f, c), EVOLINK_TABLE_16(f, c + 16), \
+								EVOLINK_TABLE_16(f, c + 32), EVOLINK_TABLE_16(f, c + 48)
+#define EVOLINK_TABLE_256(f)	EVOLINK_TABLE_64(f, 0), EVOLINK_TABLE_64(f, 64), \
+								EVOLINK_TABLE_64(f, 128), EVOLINK_TABLE_64(f, 192)
+
+const uint8_t EvoAll::DispatchTables::message_index[256] EVOLINK_PROGMEM = {
+		EVOLINK_TABLE_256(EvoAll::DispatchTables::messageIndex)
+};
 
-		// WARNING: code below expects Request_Temperature to be the
-		// LAST VALUE in this list--leave as array terminator, or adapt code as required
-		EvoAll::RequestWithResponse(DataLink::Request_Temperature, request_response_temperature)
+const uint8_t EvoAll::DispatchTables::request_index[256] EVOLINK_PROGMEM = {
+		EVOLINK_TABLE_256(EvoAll::DispatchTables::requestIndex)
+};
 
+#ifdef EVOLINK_COMMAND_SUPPRESSION_ENABLE
+const uint8_t EvoAll::DispatchTables::output_index[256] EVOLINK_PROGMEM = {
+		EVOLINK_TABLE_256(EvoAll::DispatchTables::outputEntry)
 };
+#endif
 
 
 EvoAll::EvoAll() :
 		callbacks(),
 		synch_getter_value_received(-1),
-		serial_setup(NULL),
-		pending_request_response(NULL),
-		pending_request_issue_time(0),
+		serial_setup(EVOLINK_SERIALPORT_NONE),
+		serial(),
+		clock_src(&SystemClock),
+		num_custom_handlers(0),
+		num_inflight(0),
+		next_request_slot(0),
 #ifdef MINTIME_BETWEEN_WAKEUPS_MS
 		last_wakeup_time(0),
 #endif
 		last_tx_time(0),
+		last_command_time(0),
+		tx_since_begin(false),
+		auto_wakeup(AUTO_WAKEUP_DEFAULT),
+		awake_window_ms(EVOLINK_AWAKE_WINDOW_MS),
+		keepalive_ms(KEEPALIVE_DEFAULT_MS),
 		auto_delay_ms(AUTODELAY_DEFAULT_MS),
-		user_specified_handler(NULL)
+		post_tx_delay_ms(0),
+		num_queued(0),
+#ifdef EVOLINK_COMMAND_SUPPRESSION_ENABLE
+		suppression_policy(COMMAND_SUPPRESSION_DEFAULT_POLICY),
+		state_refresh_ms(COMMAND_STATE_REFRESH_DEFAULT_MS),
+		commands_suppressed(0),
+#endif
+		seq_steps(NULL),
+		seq_in_flash(false),
+		seq_index(0),
+		seq_step_started(false),
+		seq_msg_seen(false),
+		seq_step_start(0),
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+		event_queue_head(0),
+#endif
+#ifdef EVOLINK_TRACE_ENABLE
+		trace_head(0),
+		trace_count(0),
+		trace_lost(0),
+#endif
+		rx_overruns_seen(0),
+		resync_pending(false),
+		input_fields_known(0)
 {
+#ifdef EVOLINK_EVENT_BUS_ENABLE
+	for (uint8_t i=0; i < EVOLINK_NUM_SUPPORTED_MESSAGES; i++)
+		subscribed[i] = 0;
+#endif
+
+#ifdef EVOLINK_COMMAND_SUPPRESSION_ENABLE
+	invalidateOutputStates();
+#endif
+
+	EVOLINK_STAT(resetStatistics());
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+	event_queue_status.pending = 0;
+	resetEventQueueStatus();
+#endif
+
+	for (uint8_t i=0; i < EVOLINK_REQUEST_POOL_SIZE; i++)
+	{
+		requests[i].req = 0;
+		requests[i].status = Request::Expired;
+		requests[i].generation = 0;
+		requests[i].notify_callbacks = false;
+		requests[i].value = -1;
+		requests[i].issue_time = 0;
+		requests[i].on_complete.clear();
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+		requests[i].notify_pending = false;
+#endif
+	}
 
 }
-void EvoAll::begin(SerialSetup serial)
+bool EvoAll::begin(SerialSetup serialSetup)
 {
-	serial_setup = serial;
-	SerialConnection::setup(serial);
+	serial_setup = serialSetup;
+	if (! serial.setup(serial_setup))
+		return false;
+
+	rx_overruns_seen = serial.rxOverruns();
+	return true;
 
 }
 
 
+#ifdef PLATFORM_POSIX
+void EvoAll::setRecorder(SessionRecorder * rec)
+{
+	if (rec)
+		rec->setClock(*clock_src);
+
+	serial.setRecorder(rec);
+}
+#endif
+
 void EvoAll::delayWhileCheckingActivity(uint16_t delayMillis, uint16_t activityCheckPeriod)
 {
 
-	uint32_t timeNow = timeMs();
-	uint32_t nextCheckTime = (timeMs() + (uint32_t)activityCheckPeriod);
-	uint32_t timeoutTime = (timeNow + (uint32_t)delayMillis);
+	uint32_t startTime = timeMs();
+	uint32_t timeNow = startTime;
+	uint32_t nextCheckTime = (startTime + (uint32_t)activityCheckPeriod);
 
 	checkActivity(); // do a preliminary  checkActivity() so we have at least 1
-	while (timeNow < timeoutTime)
+	// differences only, so the loop survives the millisecond counter wrapping
+	while ((uint32_t)(timeNow - startTime) < (uint32_t)delayMillis)
 	{
-		if (timeNow >= nextCheckTime)
+		if ((int32_t)(timeNow - nextCheckTime) >= 0)
 		{
 			checkActivity();
 			nextCheckTime = timeNow + (uint32_t)activityCheckPeriod;
+		} else if (num_queued || seq_steps)
+		{
+			// keep the queued commands (and any sequence) flowing
+			serviceDeadlines();
 		}
 
-		delayMs(20);
+		uint16_t nap = 20;
+		if (num_queued && ! canTransmit())
+		{
+			// wake up in time for the next command
+			uint32_t untilTx = nextTransmitTime() - timeMs();
+			if (untilTx < nap)
+				nap = untilTx ? untilTx : 1;
+		}
+		delayMs(nap);
 
 		timeNow = timeMs();
 
@@ -231,242 +372,635 @@ void EvoAll::delayWhileCheckingActivity(uint16_t delayMillis, uint16_t activityC
 	return;
 
 }
-void EvoAll::checkActivity(uint16_t timeout)
+uint16_t EvoAll::processIncoming()
 {
-	bool msgRcvd = false;
-	uint32_t maxMs = (timeMs() + (uint32_t)timeout);
-
-
-	int c;
-	do {
-		while (SerialConnection::available())
-		{
-			c = SerialConnection::read();
-#ifdef DEBUG_USART_ENABLE
-			if (serial_setup.debug_usart)
-			{
-				serial_setup.debug_usart->print(F("Evo rcvd: 0x"));
-				serial_setup.debug_usart->println(c, HEX);
-			}
-#endif
+	uint8_t buf[EVOLINK_RX_CHUNK_SIZE];
+	uint16_t numProcessed = 0;
+	size_t numRead;
+	while ((numRead = serial.readBytes(buf, EVOLINK_RX_CHUNK_SIZE)))
+	{
+		parseMessages(buf, numRead);
+		numProcessed += numRead;
+	}
+	checkOverruns();
 
+	return numProcessed;
+}
 
-			msgRcvd = parseMessage(c);
-			if (! SerialConnection::available())
-			{
-				// apparently nothing left in the buffer
-				// allow a little time to get the next byte,
-				// if it's actually still coming down the wire.
-				// Assuming 9600 baud, 8+2 bits would take a bit less than 1ms
-				delayUs(950);
-			}
+bool EvoAll::nextDeadline(uint32_t & deadline)
+{
+	bool haveDeadline = false;
+	if (num_inflight)
+	{
+		// oldest in flight is always the first to time out
+		deadline = requests[inflight[0]].issue_time + ABS_REQUEST_RESPONSE_TIMEOUT_MS;
+		haveDeadline = true;
+	}
 
+	if (nextQueuedCommand() >= 0)
+	{
+		uint32_t txTime = canTransmit() ? timeMs() : nextTransmitTime();
+		if ((! haveDeadline) || ((int32_t)(txTime - deadline) < 0))
+		{
+			deadline = txTime;
 		}
+		haveDeadline = true;
+	}
 
-		if (timeout)
+	uint32_t keepAliveTime;
+	if (keepAliveDue(keepAliveTime))
+	{
+		if ((! haveDeadline) || ((int32_t)(keepAliveTime - deadline) < 0))
 		{
-			delayUs(500);
+			deadline = keepAliveTime;
 		}
+		haveDeadline = true;
+	}
 
-
-	} while ((!msgRcvd) && (maxMs > timeMs()));
-}
-
-
-EvoAll::MessageCodeCallback * EvoAll::codeToCallbackEntryFor(uint8_t raw_msg_code)
-{
-
-	uint8_t termination_entry = (uint8_t)(DataLink::Temperature_Error);
-
-
-	uint8_t i=0;
-	do {
-
-		if (callback_assocs[i].raw_msg_code == raw_msg_code)
+	if (seq_steps && (seq_step.action == Sequence::Delay ||
+			(seq_step.action == Sequence::WaitFor && seq_step.ms)))
+	{
+		// end of the delay, or of the wait
+		uint32_t seqTime = seq_step_start + seq_step.ms;
+		if ((! haveDeadline) || ((int32_t)(seqTime - deadline) < 0))
 		{
-			// found it...
-			return &(callback_assocs[i]);
-
+			deadline = seqTime;
 		}
+		haveDeadline = true;
+	}
 
-	} while (callback_assocs[i++].raw_msg_code != termination_entry);
-
-
-	// if we get here, we don't know whatch you're talkin' 'bout, Willis...
-	return NULL;
-}
-
-GenericMessageHandler EvoAll::handlerForMessage(DataLink::MessageCode msg)
-{
-	return handlerForMessage((uint8_t)msg);
+	return haveDeadline;
 }
 
-
-GenericMessageHandler EvoAll::handlerForMessage(uint8_t raw_msg_code)
+void EvoAll::serviceDeadlines()
 {
+	while (num_inflight &&
+			((timeMs() - requests[inflight[0]].issue_time) >= ABS_REQUEST_RESPONSE_TIMEOUT_MS))
+	{
+		// waited long enough, give up on this one.
+		finishRequest(inflight[0], Request::TimedOut);
+	}
 
-	EvoAll::MessageCodeCallback * entryForMsg = codeToCallbackEntryFor(raw_msg_code);
+	pumpQueue();
 
-	if (entryForMsg) {
-		return entryForMsg->callback;
+	if (resync_pending)
+	{
+		// the queue was full when the overrun was noticed
+		queueResync();
 	}
 
-	// not found
-	return NULL;
+	serviceSequence();
 
+	uint32_t keepAliveTime;
+	if (keepAliveDue(keepAliveTime) && ((int32_t)(timeMs() - keepAliveTime) >= 0)
+			&& canTransmit())
+	{
+		// nudge it, before it dozes off
+		sendRequest(DataLink::WakeUp);
+	}
+}
 
+bool EvoAll::deviceAwake()
+{
+	// a window of 0: once woken, it never dozes off
+	return tx_since_begin && ((! awake_window_ms) || (timeMs() - last_tx_time) < awake_window_ms);
 }
-bool EvoAll::setHandlerForMessage(DataLink::MessageCode code, GenericMessageHandler useCallback)
+
+bool EvoAll::keepAliveDue(uint32_t & when)
 {
+	if (! (keepalive_ms && awake_window_ms && tx_since_begin) || num_queued)
+		return false; // not keeping alive (or no need), or the queue will do it
 
-	EvoAll::MessageCodeCallback * entryForMsg = codeToCallbackEntryFor((uint8_t)code);
-	if (entryForMsg) {
-		entryForMsg->callback = useCallback;
-		return true;
-	}
+	if ((timeMs() - last_command_time) >= keepalive_ms)
+		return false; // been quiet long enough, let it sleep
 
-	// couldn't locate, couldn't set.
-	return false;
+	// about 2/3 of the way through the awake window
+	when = last_tx_time + ((awake_window_ms * 2) / 3);
+	if ((int32_t)(when - nextTransmitTime()) < 0)
+		when = nextTransmitTime();
 
+	return true;
 }
 
-
-bool EvoAll::parseMessage(int msg)
+void EvoAll::checkActivity(uint16_t timeout)
 {
-	if (msg < 0)
-		return false; // nothing read
+	bool msgRcvd = false;
+	uint32_t startTime = timeMs();
+	uint32_t idleGapUs = (serial.characterTimeUs() * EVOLINK_IDLE_GAP_PERCENT) / 100;
 
-	// first, check if we're currently waiting on a response byte to one of the data requests
-	if (pending_request_response)
-	{
-		// yep!
 
-		// first, make sure it's even possible that this is our message (if it arrives too
-		// quickly, might be a race condition--i.e. send tach request, door opens, tach req response arrives
-		uint32_t curTime = timeMs();
+	uint8_t buf[EVOLINK_RX_CHUNK_SIZE];
+	size_t numRead;
+	for (;;) {
+		serviceDeadlines();
 
-		if (curTime < pending_request_issue_time)
+		while ((numRead = serial.readBytes(buf, EVOLINK_RX_CHUNK_SIZE)))
 		{
+			if (parseMessages(buf, numRead))
+				msgRcvd = true;
 
-
-#ifdef DEBUG_USART_ENABLE
-			if (serial_setup.debug_usart)
+			if (! serial.available())
 			{
-				serial_setup.debug_usart->println(F("Evo expt resp time loop"));
+				// apparently nothing left in the buffer
+				// allow a little time to get the next byte,
+				// if it's actually still coming down the wire.
+				clock_src->waitForData(serial, idleGapUs);
 			}
-#endif
 
-			// edge case -- we've looped around the system timer just as we were awaiting a response
-			if (callbacks.error_event)
-				callbacks.error_event(ErrorMessage::RequestTimeout, pending_request_response->req);
+		}
+		checkOverruns();
 
-			resetPendingRequest(); // scrap it.
-			return false;
-		} else if (curTime >= (pending_request_issue_time + ABS_REQUEST_RESPONSE_TIME_MINIMUM_MS))
+		uint32_t elapsed = timeMs() - startTime;
+		if (msgRcvd || elapsed >= timeout)
+			return;
+
+		// sleep until something comes in, or it's time to
+		// service the queue/pending requests
+		uint32_t waitMs = timeout - elapsed;
+		uint32_t deadline;
+		if (nextDeadline(deadline))
 		{
+			int32_t untilDeadline = (int32_t)(deadline - timeMs());
+			if (untilDeadline < 0)
+				untilDeadline = 0;
 
+			if ((uint32_t)untilDeadline < waitMs)
+				waitMs = untilDeadline;
+		}
 
-			// this should be the response we were hoping for
+		clock_src->waitForData(serial, waitMs * 1000UL);
 
+	}
+}
 
-#ifdef DEBUG_USART_ENABLE
-			if (serial_setup.debug_usart)
-			{
-				serial_setup.debug_usart->println(F("Evo got resp"));
-			}
-#endif
 
+int8_t EvoAll::messageIndexFor(uint8_t raw_msg_code)
+{
+	static_assert(DispatchTables::messagesUnique(), "duplicate entry in message_families[]");
 
+	uint8_t idx = EVOLINK_PGM_READ_BYTE(&(DispatchTables::message_index[raw_msg_code]));
+	if (idx == EVOLINK_NO_TABLE_ENTRY)
+	{
+		// we don't know whatch you're talkin' 'bout, Willis...
+		return -1;
+	}
 
-			if (callbacks.requested_data_received)
-			{
-				int respVal = (pending_request_response->processor != NULL) ?
-						pending_request_response->processor(pending_request_response->req, msg) : msg;
+	return idx;
+}
 
-#ifdef DEBUG_USART_ENABLE
-				if (serial_setup.debug_usart)
-				{
-					serial_setup.debug_usart->print(F("Evo calling handle w/val: "));
-					serial_setup.debug_usart->println(respVal, DEC);
-				}
-#endif
+bool EvoAll::supportsMessage(uint8_t raw_msg_code)
+{
+	return (messageIndexFor(raw_msg_code) >= 0);
+}
 
+GenericMessageCallback EvoAll::handlerForMessage(DataLink::MessageCode msg)
+{
+	return handlerForMessage((uint8_t)msg);
+}
 
 
-				callbacks.requested_data_received(pending_request_response->req, respVal);
-			}
+GenericMessageCallback EvoAll::handlerForMessage(uint8_t raw_msg_code)
+{
 
+	int8_t idx = messageIndexFor(raw_msg_code);
 
-			resetPendingRequest();
-			return true;
-		}
+	CustomHandler * custom = customHandlerFor(idx);
+	if (custom) {
+		return custom->handler;
+	}
 
+	// not found, or not overridden
+	return GenericMessageCallback();
 
-	}
 
+}
+bool EvoAll::setHandlerForMessage(DataLink::MessageCode code, GenericMessageHandler useCallback)
+{
 
-	// we get here, either we aren't waiting for a response, or it's still too early for it
-	// to arrive--must be a standard message...
+	return setCustomHandler(messageIndexFor((uint8_t)code), useCallback);
+}
 
-	uint8_t msgcode = (uint8_t)msg;
-	GenericMessageHandler handler = handlerForMessage(msgcode);
+bool EvoAll::setHandlerForMessage(DataLink::MessageCode code,
+		GenericMessageCallback::ContextFunction useCallback, void * context)
+{
+	GenericMessageCallback handler;
+	handler.set(useCallback, context);
+	return setCustomHandler(messageIndexFor((uint8_t)code), handler);
+}
+
+EvoAll::CustomHandler * EvoAll::customHandlerFor(int8_t idx)
+{
+	for (uint8_t i=0; i < num_custom_handlers; i++)
+	{
+		if (custom_handlers[i].msg_idx == idx)
+			return &(custom_handlers[i]);
+	}
+	return NULL;
+}
+
+bool EvoAll::setCustomHandler(int8_t idx, const GenericMessageCallback & handler)
+{
+	if (idx < 0)
+		return false; // couldn't locate, couldn't set.
 
-	if (handler) {
-		// got a handler for this message type -- use it.
-		handler((DataLink::MessageCode) msgcode);
+	CustomHandler * custom = customHandlerFor(idx);
+	if (! handler)
+	{
+		// back to the callbacks: free the entry, keeping the table packed
+		if (custom)
+			*custom = custom_handlers[--num_custom_handlers];
 		return true;
 	}
 
-	// could not locate...
-	if (callbacks.error_event) {
-		// have an error handler setup, notify:
-		callbacks.error_event(ErrorMessage::UnsupportedValue, msgcode);
+	if (! custom)
+	{
+		if (num_custom_handlers >= EVOLINK_MAX_CUSTOM_HANDLERS)
+			return false;
+		custom = &(custom_handlers[num_custom_handlers++]);
+		custom->msg_idx = idx;
 	}
+	custom->handler = handler;
+	return true;
+}
 
+#ifdef EVOLINK_EVENT_BUS_ENABLE
+/*
+ * Event bus
+ *
+ * Masks aren't kept: subscribing sets the subscriber's bit in
+ * subscribed[] for each supported message its mask selects, so
+ * publishing only visits the subscribers that want the message.
+ */
+int8_t EvoAll::freeSubscriberSlot()
+{
+	for (uint8_t i=0; i < EVOLINK_MAX_SUBSCRIBERS; i++)
+	{
+		if (! subscribers[i])
+			return i;
+	}
+	return -1;
+}
 
-	return false;
+int8_t EvoAll::subscribe(const MessageMask & mask, GenericMessageHandler handler)
+{
+	int8_t id = freeSubscriberSlot();
+	if (id < 0 || ! handler)
+		return -1;
 
+	subscribers[id] = handler;
+	resubscribe(id, mask);
+	return id;
 }
 
-
-bool EvoAll::wakeUp()
+int8_t EvoAll::subscribe(const MessageMask & mask,
+		GenericMessageCallback::ContextFunction handler, void * context)
 {
-	// handle the wake-up a bit differently, as we
-	// a) know it doesn't get a response and
-	// b) may want to do wakeups automatically
+	int8_t id = freeSubscriberSlot();
+	if (id < 0 || ! handler)
+		return -1;
 
-#ifdef MINTIME_BETWEEN_WAKEUPS_MS
-	uint32_t timenow = timeMs();
-	if ( (timenow - last_wakeup_time) < MINTIME_BETWEEN_WAKEUPS_MS)
-	{
-		// ignore this, too soon...
-#ifdef DEBUG_USART_ENABLE
-			if (serial_setup.debug_usart)
-			{
-				serial_setup.debug_usart->println(F("Evo::wakeUp() but already awake, skip."));
-			}
-#endif
+	subscribers[id].set(handler, context);
+	resubscribe(id, mask);
+	return id;
+}
 
+bool EvoAll::resubscribe(int8_t id, const MessageMask & mask)
+{
+	if (id < 0 || id >= EVOLINK_MAX_SUBSCRIBERS || ! subscribers[id])
 		return false;
-	}
-	// ok, been long enough to issue a new wake-up
-	last_wakeup_time = timenow;
-#endif
 
-	sendRequest(DataLink::WakeUp);
-
-#ifdef POSTWAKEUP_AUTO_DELAY_MS
-	delayMs(POSTWAKEUP_AUTO_DELAY_MS);
-#endif
+	uint8_t bit = (1 << id);
+	for (uint8_t i=0; i < EVOLINK_NUM_SUPPORTED_MESSAGES; i++)
+	{
+		if (mask.has(DispatchTables::message_families[i].raw_msg_code))
+			subscribed[i] |= bit;
+		else
+			subscribed[i] &= ~bit;
+	}
 	return true;
 }
 
+bool EvoAll::unsubscribe(int8_t id)
+{
+	if (! resubscribe(id, MessageMask()))
+		return false;
+
+	subscribers[id].clear();
+	return true;
+}
+
+void EvoAll::publish(int8_t idx, uint8_t msgcode)
+{
+	uint8_t who = subscribed[idx];
+	for (uint8_t i=0; who; i++, who >>= 1)
+	{
+		// a handler may well unsubscribe someone, so check
+		if ((who & 0x01) && subscribers[i])
+			subscribers[i](*this, (DataLink::MessageCode)msgcode);
+	}
+}
+#endif
+
+/*
+ * Event dispatcher
+ *
+ * Used internally to trigger appropriate callbacks
+ * for various event (message) codes received.
+ *
+ */
+void EvoAll::deliverMessage(int8_t idx, uint8_t msgcode)
+{
+	CustomHandler * custom = customHandlerFor(idx);
+	if (custom)
+	{
+		// got a custom handler for this message type -- use it.
+		custom->handler(*this, (DataLink::MessageCode) msgcode);
+	} else {
+		dispatchToCallbacks(DispatchTables::message_families[idx].family, msgcode);
+	}
+#ifdef EVOLINK_EVENT_BUS_ENABLE
+	publish(idx, msgcode);
+#endif
+}
+
+void EvoAll::notifyError(ErrorMessage::Event event, uint8_t param)
+{
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+	deferEvent(Deferred::Error, (uint8_t)event, param);
+#else
+	if (callbacks.error_event)
+		callbacks.error_event(*this, event, param);
+#endif
+}
+
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+/*
+ * Deferred events
+ */
+bool EvoAll::deferEvent(Deferred::Kind kind, uint8_t code, int value,
+		RequestHandle request)
+{
+	if (event_queue_status.pending >= EVOLINK_EVENT_QUEUE_SIZE)
+	{
+		// keep what's there, in order: drop the newcomer (responses
+		// aren't lost, their slot still has notify_pending set)
+		if (kind != Deferred::Response && event_queue_status.dropped < 0xffff)
+			event_queue_status.dropped++;
+		return false;
+	}
+
+	PendingEvent & evt = event_queue[(uint8_t)(event_queue_head + event_queue_status.pending)
+									 & (EVOLINK_EVENT_QUEUE_SIZE - 1)];
+	evt.time_ms = timeMs();
+	evt.value = value;
+	evt.request = request;
+	evt.code = code;
+	evt.kind = kind;
+
+	if (++event_queue_status.pending > event_queue_status.high_water)
+		event_queue_status.high_water = event_queue_status.pending;
+
+	return true;
+}
+
+uint16_t EvoAll::dispatchPending(uint16_t maxEvents)
+{
+	uint16_t numDispatched = 0;
+	while (event_queue_status.pending && numDispatched < maxEvents)
+	{
+		// pop before delivering: callbacks may well checkActivity(),
+		// queueing more.
+		PendingEvent evt = event_queue[event_queue_head++ & (EVOLINK_EVENT_QUEUE_SIZE - 1)];
+		event_queue_status.pending--;
+		numDispatched++;
+
+		uint32_t waited = timeMs() - evt.time_ms;
+		if (waited > event_queue_status.max_wait_ms)
+			event_queue_status.max_wait_ms = waited;
+
+		switch (evt.kind)
+		{
+		case Deferred::Error:
+			if (callbacks.error_event)
+				callbacks.error_event(*this, (ErrorMessage::Event)evt.code, (uint8_t)evt.value);
+			break;
+
+		case Deferred::Response:
+		{
+			DataRequest * r = requestFor(evt.request);
+			if (r && r->notify_pending)
+				notifyCompletion(*r);
+			break;
+		}
+
+		default:
+			deliverMessage(messageIndexFor(evt.code), evt.code);
+			break;
+		}
+	}
+
+	// finished requests that didn't fit in the queue
+	for (uint8_t i=0; i < EVOLINK_REQUEST_POOL_SIZE &&
+			! event_queue_status.pending && numDispatched < maxEvents; i++)
+	{
+		if (requests[i].notify_pending)
+		{
+			notifyCompletion(requests[i]);
+			numDispatched++;
+		}
+	}
+
+	return numDispatched;
+}
+
+void EvoAll::resetEventQueueStatus()
+{
+	event_queue_status.high_water = event_queue_status.pending;
+	event_queue_status.dropped = 0;
+	event_queue_status.max_wait_ms = 0;
+}
+#endif
+
+void EvoAll::dispatchToCallbacks(uint8_t family, uint8_t msgcode)
+{
+	switch (family)
+	{
+	case Family_RemoteStarter:
+		if (callbacks.remotestarter_event)
+			callbacks.remotestarter_event(*this, (RemoteStarter::Event)msgcode);
+		break;
+
+	case Family_OpenClose:
+		if (callbacks.openclose_event)
+			callbacks.openclose_event(*this, (OpenClose::Event)msgcode);
+		break;
+
+	case Family_Brake:
+		if (callbacks.brake_event)
+			callbacks.brake_event(*this, (Brake::Event)msgcode);
+		break;
+
+	case Family_Sensor:
+		if (callbacks.sensor_event)
+			callbacks.sensor_event(*this, (Sensor::Event)msgcode);
+		break;
+
+	case Family_Tach:
+		if (callbacks.tach_event)
+			callbacks.tach_event(*this, (Tach::Event)msgcode);
+		break;
+
+	case Family_Generic:
+		if (callbacks.message_received)
+			callbacks.message_received(*this, (DataLink::MessageCode)msgcode);
+		break;
+
+	case Family_Error:
+		if (callbacks.error_event)
+			callbacks.error_event(*this, (ErrorMessage::Event)msgcode, 0);
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+uint16_t EvoAll::parseMessages(const uint8_t * bytes, size_t len)
+{
+	uint16_t numHandled = 0;
+	for (size_t i=0; i < len; i++)
+	{
+		if (parseMessage(bytes[i]))
+			numHandled++;
+	}
+
+	return numHandled;
+}
+
+bool EvoAll::parseMessage(int msg)
+{
+	if (msg < 0)
+		return false; // nothing read
+
+	EVOLINK_STAT(stats.bytes_rx++);
+
+	// first, check if we're currently waiting on a response byte to one of the data requests
+	if (num_inflight)
+	{
+		// yep!  Nothing that would be answered sooner went out behind it
+		// (see nextQueuedCommand()), so this can only be a response to
+		// the oldest request still in flight.
+
+		// first, make sure it's even possible that this is our message (if it arrives too
+		// quickly, might be a race condition--i.e. send tach request, door opens, tach req response arrives
+		DataRequest & pending = requests[inflight[0]];
+		if ((timeMs() - pending.issue_time) >= ABS_REQUEST_RESPONSE_TIME_MINIMUM_MS)
+		{
+
+
+			// this should be the response we were hoping for
+
+
+			EVOLINK_TRACE(Trace::Response, msg);
+
+			const RequestWithResponse * reqsResponse =
+					reqWithResponseEntryFor((DataLink::RequestCode)pending.req);
+			int respVal = (reqsResponse && reqsResponse->processor != NULL) ?
+					reqsResponse->processor((DataLink::RequestCode)pending.req, msg) : msg;
+
+			finishRequest(inflight[0], Request::Complete, respVal);
+			return true;
+		}
+
+
+	}
+
+
+	// we get here, either we aren't waiting for a response, or it's still too early for it
+	// to arrive--must be a standard message...
+
+	uint8_t msgcode = (uint8_t)msg;
+	int8_t idx = messageIndexFor(msgcode);
+
+	if (idx >= 0) {
+		updateInputCache(msgcode);
+		EVOLINK_TRACE(Trace::Dispatched, msgcode);
+		EVOLINK_STAT(stats.events[DispatchTables::message_families[idx].family]++);
+
+		if (seq_steps)
+		{
+			// catch up first: the command we're waiting on a reply to
+			// may have gone out since the sequence was last serviced.
+			serviceSequence();
+			if (seq_steps && seq_step.action == Sequence::WaitFor && seq_step.code == msgcode)
+				seq_msg_seen = true;
+		}
+
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+		deferEvent(Deferred::Message, msgcode, 0);
+#else
+		deliverMessage(idx, msgcode);
+#endif
+		return true;
+	}
+
+	// could not locate...
+	EVOLINK_STAT(stats.unsupported_values++);
+	EVOLINK_TRACE(Trace::Unsupported, msgcode);
+	notifyError(ErrorMessage::UnsupportedValue, msgcode);
+
+
+	return false;
+
+}
+
+
+bool EvoAll::wakeUp()
+{
+	// handle the wake-up a bit differently, as we
+	// a) know it doesn't get a response and
+	// b) may want to do wakeups automatically
+
+	bool alreadyQueued = false;
+	for (uint8_t i=0; i < num_queued; i++)
+	{
+		if (command_queue[i].req == DataLink::WakeUp)
+			alreadyQueued = true;
+	}
+
+	if (alreadyQueued || (deviceAwake() && ! num_queued))
+	{
+		// no need, it's awake (or will be by the time anything
+		// queued goes out)
+		EVOLINK_TRACE(Trace::WakeSkipped, DataLink::WakeUp);
+		return false;
+	}
+
+#ifdef MINTIME_BETWEEN_WAKEUPS_MS
+	uint32_t timenow = timeMs();
+	if ( (timenow - last_wakeup_time) < MINTIME_BETWEEN_WAKEUPS_MS)
+	{
+		// ignore this, too soon...
+		EVOLINK_TRACE(Trace::WakeSkipped, DataLink::WakeUp);
+
+		return false;
+	}
+	// ok, been long enough to issue a new wake-up
+	last_wakeup_time = timenow;
+#endif
+
+	// any POSTWAKEUP_AUTO_DELAY_MS is applied to whatever is sent next,
+	// by the command queue
+	return queueRequest(DataLink::WakeUp, Priority::WakeUp);
+}
+
+
 
 
 
 
 
-
 /* request shortcut methods
  * Most of these offer two methods of access:
  * xxxOn()/xxxOff()
@@ -486,11 +1020,8 @@ bool EvoAll::arm(State::SetTo onOrOff) {
 }
 
 bool EvoAll::groundOutOn() {
-	bool r = makeRequest(DataLink::GroundOut_On);
-#ifdef POSTGROUNDOUT_ON_DELAY_MS
-	delayMs(POSTGROUNDOUT_ON_DELAY_MS);
-#endif
-	return r;
+	// any POSTGROUNDOUT_ON_DELAY_MS is handled by the command queue
+	return makeRequest(DataLink::GroundOut_On);
 }
 bool EvoAll::groundOutOff() {
 	return makeRequest(DataLink::GroundOut_Off);
@@ -634,17 +1165,17 @@ bool EvoAll::remoteToggle() {
 // the request simply performs the request -- it is asynchronous.
 // Your callbacks.requested_data_received callback
 // function will be called whenever the response comes in.
-bool EvoAll::requestTach() {
-	return makeRequest(DataLink::Request_Tach);
+RequestHandle EvoAll::requestTach() {
+	return requestData(DataLink::Request_Tach);
 }
-bool EvoAll::requestVSS() {
-	return makeRequest(DataLink::Request_VSS);
+RequestHandle EvoAll::requestVSS() {
+	return requestData(DataLink::Request_VSS);
 }
-bool EvoAll::requestStatus() {
-	return makeRequest(DataLink::Request_Input);
+RequestHandle EvoAll::requestStatus() {
+	return requestData(DataLink::Request_Input);
 }
-bool EvoAll::requestTemperature() {
-	return makeRequest(DataLink::Request_Temperature);
+RequestHandle EvoAll::requestTemperature() {
+	return requestData(DataLink::Request_Temperature);
 }
 
 /*
@@ -697,125 +1228,1141 @@ int16_t EvoAll::getTemperature(uint16_t timeout) {
 
 
 
-bool EvoAll::makeRequest(DataLink::RequestCode reqCode)
+bool EvoAll::makeRequest(DataLink::RequestCode reqCode, uint16_t expiresInMs)
 {
-#ifdef AUTO_CHECKACTIVITY_BEFORE_REQUESTS
-	checkActivity();
-#endif
+	return queueRequest(reqCode, priorityFor(reqCode), expiresInMs);
+}
 
-	EvoAll::RequestWithResponse * reqsResponse =  EvoAll::reqWithResponseEntryFor(reqCode);
+bool EvoAll::forceRequest(DataLink::RequestCode reqCode, uint16_t expiresInMs)
+{
+	return queueRequest(reqCode, priorityFor(reqCode), expiresInMs, true);
+}
 
-	if (reqsResponse)
+Priority::Level EvoAll::priorityFor(DataLink::RequestCode reqCode)
+{
+	switch (reqCode)
 	{
-		// oh, a special guy...
+	case DataLink::WakeUp:
+		return Priority::WakeUp;
+
+	case DataLink::Panic_On:
+	case DataLink::StarterKill_On:
+	case DataLink::Alarm_On:
+		return Priority::Critical;
+
+	case DataLink::Request_Temperature:
+	case DataLink::Request_Tach:
+	case DataLink::Request_VSS:
+	case DataLink::Request_Input:
+	case DataLink::Ping_Request:
+	case DataLink::Pong_Request:
+		return Priority::Telemetry;
 
-		if (pending_request_response)
-		{
-			// one at a time, boys..
-			return false;
-		}
-		prepareRequestNeedingResponse(reqsResponse);
+	default:
+		break;
 	}
 
-	sendRequest(reqCode);
-	return true;
+	return Priority::Normal;
 }
 
+bool EvoAll::queueRequest(DataLink::RequestCode reqCode, Priority::Level priority,
+		uint16_t expiresInMs, bool force)
+{
+#ifdef AUTO_CHECKACTIVITY_BEFORE_REQUESTS
+	checkActivity();
+#endif
 
+	return queueCommand(reqCode, priority, expiresInMs, force, false);
+}
 
+bool EvoAll::queueCommand(DataLink::RequestCode reqCode, Priority::Level priority,
+		uint16_t expiresInMs, bool force, bool fromSequence)
+{
+	if (reqWithResponseEntryFor(reqCode))
+	{
+		// oh, a special guy...
+		return submitRequest(reqCode, priority, expiresInMs, NULL, true,
+				fromSequence).valid();
+	}
 
-InputStatus EvoAll::getStatus(uint16_t timeout) {
-	 int16_t val = synchronousGet(timeout, DataLink::Request_Input);
-	 if (val < 0)
-	 {
-		 return InputStatus();
-	 }
-
-	 return InputStatus((uint8_t)val);
+#ifdef EVOLINK_COMMAND_SUPPRESSION_ENABLE
+	uint8_t outputEntry = outputEntryFor(reqCode);
+	if (outputEntry != EVOLINK_NO_TABLE_ENTRY && ! force && suppressRedundant(outputEntry))
+	{
+		// already so, nothing to do
+		commands_suppressed++;
+		EVOLINK_TRACE(Trace::Suppressed, reqCode);
+		return true;
+	}
 
+	// the output's state is recorded once the command actually goes out
+#else
+	(void)force;
+#endif
+	return enqueue(reqCode, priority, expiresInMs, 0xff, fromSequence);
 }
 
-int16_t EvoAll::synchronousGet(uint16_t timeout, DataLink::RequestCode code) {
-
-	checkActivity(105); // clear the buffer
+#ifdef EVOLINK_COMMAND_SUPPRESSION_ENABLE
+/*
+ * Command suppression
+ */
+#define OUTPUT_STATE_UNKNOWN	0
+#define OUTPUT_STATE_OFF		1
+#define OUTPUT_STATE_ON			2
 
+uint8_t EvoAll::outputEntryFor(uint8_t reqCode)
+{
+	static_assert(DispatchTables::outputsUnique(), "duplicate entry in output_pairs[]");
 
-#ifdef DEBUG_USART_ENABLE
-	if (serial_setup.debug_usart)
-	{
-		serial_setup.debug_usart->print(F("Evo synchGet: 0x"));
-		serial_setup.debug_usart->println((int)code, HEX);
-	}
-#endif
+	return EVOLINK_PGM_READ_BYTE(&(DispatchTables::output_index[reqCode]));
+}
 
+bool EvoAll::suppressRedundant(uint8_t outputEntry)
+{
+	if (suppression_policy == Suppression::Disabled)
+		return false;
 
+	uint8_t idx = outputEntry & ~EVOLINK_OUTPUT_ON;
+	uint8_t state = (outputEntry & EVOLINK_OUTPUT_ON) ? OUTPUT_STATE_ON : OUTPUT_STATE_OFF;
 
-	synchronousValueGetterSetup();
-	if (makeRequest(code))
+	// whatever's queued for this output will have the last word
+	int8_t pending = -1;
+	for (uint8_t i=0; i < num_queued; i++)
 	{
-		// request sent
-		// now get the response
-		delay(40);
-		checkActivity(timeout);
+		uint8_t entry = outputEntryFor(command_queue[i].req);
+		if (entry == EVOLINK_NO_TABLE_ENTRY || (entry & ~EVOLINK_OUTPUT_ON) != idx)
+			continue;
+
+		// the last to go out: lowest priority, latest submitted
+		if (pending < 0 || command_queue[i].priority >= command_queue[pending].priority)
+			pending = i;
 	}
-	synchronousValueGetterTeardown();
+	if (pending >= 0)
+		return (outputEntryFor(command_queue[pending].req) == outputEntry);
 
-	if (synch_getter_value_received < 0)
-	{
+	if (output_state[idx] != state)
+		return false;
 
+	if (state_refresh_ms && ((timeMs() - output_sent_time[idx]) >= state_refresh_ms))
+		return false; // time to re-assert it
 
-#ifdef DEBUG_USART_ENABLE
-		if (serial_setup.debug_usart)
-		{
-			serial_setup.debug_usart->println(F("Evo nothing returned in time"));
-		}
-#endif
+	return true;
+}
 
-		if (callbacks.error_event)
-			callbacks.error_event(ErrorMessage::RequestTimeout, code);
-	}
+void EvoAll::recordOutput(uint8_t outputEntry)
+{
+	uint8_t idx = outputEntry & ~EVOLINK_OUTPUT_ON;
+	output_state[idx] = (outputEntry & EVOLINK_OUTPUT_ON) ? OUTPUT_STATE_ON : OUTPUT_STATE_OFF;
+	output_sent_time[idx] = timeMs();
+}
 
-	return synch_getter_value_received;
+void EvoAll::setCommandSuppression(Suppression::Policy policy, uint32_t refreshMs)
+{
+	suppression_policy = policy;
+	state_refresh_ms = refreshMs;
+}
 
+void EvoAll::invalidateOutputStates()
+{
+	for (uint8_t i=0; i < EVOLINK_NUM_OUTPUT_PAIRS; i++)
+	{
+		output_state[i] = OUTPUT_STATE_UNKNOWN;
+		output_sent_time[i] = 0;
+	}
 }
+#endif
 
+#ifdef EVOLINK_STATISTICS_ENABLE
+/*
+ * Link statistics
+ */
+static const uint16_t latency_bucket_bounds[EVOLINK_STATS_LATENCY_BUCKETS - 1] =
+		EVOLINK_STATS_LATENCY_BUCKET_BOUNDS;
 
-void EvoAll::sendRequest(DataLink::RequestCode reqCode)
+void EvoAll::resetStatistics()
 {
-	if (auto_delay_ms)
-	{
-		uint32_t curTime = timeMs();
+	static_assert((uint8_t)Stats::NumFamilies == (uint8_t)Family_Error + 1,
+			"Stats::Family out of step with MessageFamily");
 
-		if (curTime < (last_tx_time + (uint32_t)auto_delay_ms))
-		{
-			
-#ifdef DEBUG_USART_ENABLE
-			if (serial_setup.debug_usart)
-			{
+	memset(&stats, 0, sizeof(stats));
+}
 
-				serial_setup.debug_usart->print(F("Evo autodelaying (ms): "));
-				serial_setup.debug_usart->println( ((last_tx_time + auto_delay_ms) - curTime), DEC);
-			}
-#endif
+uint16_t EvoAll::latencyBucketMaxMs(uint8_t bucket)
+{
+	if (bucket >= (EVOLINK_STATS_LATENCY_BUCKETS - 1))
+		return 0;
 
-			delayMs((last_tx_time + (uint32_t)auto_delay_ms) - curTime);
-		}
+	return latency_bucket_bounds[bucket];
+}
 
-		last_tx_time = timeMs();
+void EvoAll::recordLatency(uint8_t reqCode, uint32_t latencyMs)
+{
+	uint8_t which;
+	switch (reqCode)
+	{
+	case DataLink::Request_Tach:
+		which = Stats::TachLatency;
+		break;
+	case DataLink::Request_VSS:
+		which = Stats::VSSLatency;
+		break;
+	case DataLink::Request_Temperature:
+		which = Stats::TemperatureLatency;
+		break;
+	case DataLink::Request_Input:
+		which = Stats::InputLatency;
+		break;
+	default:
+		return;
 	}
 
-#ifdef DEBUG_USART_ENABLE
-	if (serial_setup.debug_usart)
+	uint8_t bucket = 0;
+	while (bucket < (EVOLINK_STATS_LATENCY_BUCKETS - 1) &&
+			latencyMs >= latency_bucket_bounds[bucket])
 	{
-		serial_setup.debug_usart->print(last_tx_time, DEC);
-		serial_setup.debug_usart->print(F(" Evo send: 0x"));
-		serial_setup.debug_usart->println(reqCode, HEX);
+		bucket++;
 	}
 
-#endif
-	uint8_t reqCodeV = reqCode;
-	SerialConnection::write(reqCodeV);
-
+	if (stats.latency[which][bucket] < 0xffff)
+		stats.latency[which][bucket]++;
+}
+#endif
+
+#ifdef EVOLINK_TRACE_ENABLE
+/*
+ * Trace ring
+ */
+bool EvoAll::drainTrace(TraceRecord & rec)
+{
+	if (! trace_count)
+		return false;
+
+	rec = trace_ring[(uint8_t)(trace_head - trace_count) & (EVOLINK_TRACE_SIZE - 1)];
+	trace_count--;
+	return true;
+}
+
+#ifdef DEBUG_USART_ENABLE
+void EvoAll::dumpTrace()
+{
+	if (! serial_setup.debug_usart)
+		return;
+
+	HardwareSerial * out = serial_setup.debug_usart;
+	if (trace_lost)
+	{
+		out->print(F("Evo trace lost "));
+		out->println(trace_lost, DEC);
+		trace_lost = 0;
+	}
+
+	TraceRecord rec;
+	while (drainTrace(rec))
+	{
+		out->print(rec.time_ms, DEC);
+		out->print(rec.transmitted() ? F(" Evo tx 0x") : F(" Evo rx 0x"));
+		out->print(rec.data, HEX);
+		out->print(' ');
+		switch (rec.decision)
+		{
+		case Trace::Dispatched:
+			out->println(F("dispatched"));
+			break;
+		case Trace::Response:
+			out->println(F("response"));
+			break;
+		case Trace::Unsupported:
+			out->println(F("unsupported"));
+			break;
+		case Trace::RequestTimeout:
+			out->println(F("timed out"));
+			break;
+		case Trace::Sent:
+			out->println(F("sent"));
+			break;
+		case Trace::AutoDelay:
+			out->println(F("sent (autodelay)"));
+			break;
+		case Trace::Suppressed:
+			out->println(F("suppressed"));
+			break;
+		case Trace::Expired:
+			out->println(F("expired"));
+			break;
+		case Trace::WakeSkipped:
+			out->println(F("wake-up skipped"));
+			break;
+		default:
+			out->println(rec.decision, HEX);
+			break;
+		}
+	}
+}
+#endif
+#endif
+
+bool EvoAll::enqueue(DataLink::RequestCode reqCode, Priority::Level priority,
+		uint16_t expiresInMs, uint8_t requestSlot, bool fromSequence)
+{
+	if (num_queued >= EVOLINK_COMMAND_QUEUE_SIZE)
+	{
+		// no room at the inn
+		return false;
+	}
+
+	QueuedCommand & cmd = command_queue[num_queued++];
+	cmd.req = (uint8_t)reqCode;
+	cmd.request_slot = requestSlot;
+	cmd.from_sequence = fromSequence;
+#if defined(EVOLINK_STATISTICS_ENABLE) || defined(EVOLINK_TRACE_ENABLE)
+	cmd.queued_time = timeMs();
+#endif
+	cmd.priority = (uint8_t)priority;
+	cmd.expires = (expiresInMs != 0);
+	cmd.expiry_time = timeMs() + expiresInMs;
+
+	// send right away, if the line is free
+	pumpQueue();
+	return true;
+}
+
+bool EvoAll::answeredAtOnce(uint8_t reqCode)
+{
+	// the EVO-All answers these as soon as it gets them, whereas tach,
+	// VSS and temperature responses take ~110 ms
+	return (reqCode == DataLink::Request_Input || reqCode == DataLink::Ping_Request
+			|| reqCode == DataLink::Pong_Request);
+}
+
+bool EvoAll::slowAnswerInFlight()
+{
+	for (uint8_t i=0; i < num_inflight; i++)
+	{
+		if (! answeredAtOnce(requests[inflight[i]].req))
+			return true;
+	}
+
+	return false;
+}
+
+int8_t EvoAll::nextQueuedCommand()
+{
+	// highest priority, earliest submitted--skipping data requests
+	// while the in-flight window is full, and anything answered at
+	// once while a slow answer is on its way: the quick answer would
+	// overtake it, and be taken for it.
+	int8_t next = -1;
+	bool windowFull = (num_inflight >= EVOLINK_MAX_INFLIGHT_REQUESTS);
+	bool slowPending = slowAnswerInFlight();
+	for (uint8_t i=0; i < num_queued; i++)
+	{
+		if (windowFull && command_queue[i].request_slot != 0xff)
+			continue;
+
+		if (slowPending && answeredAtOnce(command_queue[i].req))
+			continue;
+
+		if (next < 0 || command_queue[i].priority < command_queue[next].priority)
+			next = i;
+	}
+
+	return next;
+}
+
+bool EvoAll::canTransmit()
+{
+	return ((timeMs() - last_tx_time) >= post_tx_delay_ms);
+}
+
+uint32_t EvoAll::nextTransmitTime()
+{
+	return last_tx_time + post_tx_delay_ms;
+}
+
+void EvoAll::pumpQueue()
+{
+	while (num_queued && canTransmit())
+	{
+		int8_t next = nextQueuedCommand();
+		if (next < 0)
+			return; // only requests left that must wait on responses
+
+		QueuedCommand cmd = command_queue[next];
+		bool expired = cmd.expires && ((int32_t)(timeMs() - cmd.expiry_time) > 0);
+		if (auto_wakeup && ! expired && cmd.req != DataLink::WakeUp && ! deviceAwake())
+		{
+			// it's dozing: wake it first, this one goes out after
+			// the post wake-up delay.
+			if (! sendRequest(DataLink::WakeUp))
+				return; // port won't take it, try again later
+			continue;
+		}
+
+		// a WakeUp someone else has beaten to it
+		bool redundant = (cmd.req == DataLink::WakeUp && deviceAwake());
+		if (! (expired || redundant))
+		{
+#if defined(EVOLINK_STATISTICS_ENABLE) || defined(EVOLINK_TRACE_ENABLE)
+			// was it held back, waiting out the previous send?
+			int32_t heldBack = (int32_t)(nextTransmitTime() - cmd.queued_time);
+			bool paced = (heldBack > 0);
+#else
+			bool paced = false;
+#endif
+			if (! sendRequest((DataLink::RequestCode)cmd.req, paced))
+				return; // port won't take it: leave it queued, try again later
+
+			EVOLINK_STAT(if (paced) stats.pacing_ms += heldBack);
+		}
+
+		num_queued--;
+		for (uint8_t i=next; i < num_queued; i++)
+		{
+			command_queue[i] = command_queue[i + 1];
+		}
+
+		if (redundant)
+			continue;
+
+		if (expired)
+		{
+			// too late for this one
+			EVOLINK_TRACE(Trace::Expired, cmd.req);
+			notifyError(ErrorMessage::CommandExpired, cmd.req);
+
+			if (cmd.request_slot != 0xff)
+				finishRequest(cmd.request_slot, Request::Dropped);
+
+			continue;
+		}
+
+		if (cmd.request_slot != 0xff)
+		{
+			requestSent(cmd.request_slot);
+		}
+	}
+}
+
+bool EvoAll::flushRequests(uint16_t timeoutMs)
+{
+	uint32_t startTime = timeMs();
+	while (num_queued)
+	{
+		if ((timeMs() - startTime) >= timeoutMs)
+			return false;
+
+		checkActivity();
+		if (num_queued)
+			delayMs(1);
+	}
+
+	return true;
+}
+
+/*
+ * Command sequences
+ */
+bool EvoAll::runSequence(const SequenceStep * steps, SequenceCompletionHandler onDone)
+{
+	return startSequence(steps, false, onDone);
+}
+
+bool EvoAll::runSequence_P(const SequenceStep * steps, SequenceCompletionHandler onDone)
+{
+	return startSequence(steps, true, onDone);
+}
+
+bool EvoAll::runSequence(const SequenceStep * steps,
+		SequenceCompletionCallback::ContextFunction onDone, void * context)
+{
+	return startSequence(steps, false, SequenceCompletionCallback(onDone, context));
+}
+
+bool EvoAll::runSequence_P(const SequenceStep * steps,
+		SequenceCompletionCallback::ContextFunction onDone, void * context)
+{
+	return startSequence(steps, true, SequenceCompletionCallback(onDone, context));
+}
+
+bool EvoAll::startSequence(const SequenceStep * steps, bool inFlash,
+		const SequenceCompletionCallback & onDone)
+{
+	if (! steps)
+		return false;
+
+	abortSequence();
+
+	seq_steps = steps;
+	seq_in_flash = inFlash;
+	seq_index = 0;
+	seq_step_started = false;
+	seq_done = onDone;
+
+	// get going on the first step(s) right away
+	serviceSequence();
+	return true;
+}
+
+void EvoAll::abortSequence()
+{
+	if (! seq_steps)
+		return;
+
+	// pull whatever it still had waiting in the queue
+	uint8_t i = 0;
+	while (i < num_queued)
+	{
+		QueuedCommand cmd = command_queue[i];
+		if (! cmd.from_sequence)
+		{
+			i++;
+			continue;
+		}
+
+		num_queued--;
+		for (uint8_t j=i; j < num_queued; j++)
+		{
+			command_queue[j] = command_queue[j + 1];
+		}
+
+		if (cmd.request_slot != 0xff)
+			finishRequest(cmd.request_slot, Request::Dropped);
+	}
+
+	finishSequence(Sequence::Aborted);
+}
+
+bool EvoAll::sequenceCommandQueued()
+{
+	for (uint8_t i=0; i < num_queued; i++)
+	{
+		if (command_queue[i].from_sequence)
+			return true;
+	}
+
+	return false;
+}
+
+void EvoAll::finishSequence(Sequence::Result result)
+{
+	SequenceCompletionCallback onDone = seq_done;
+	uint8_t step = seq_index;
+
+	// clear out first, so the handler may start another
+	seq_steps = NULL;
+	seq_done.clear();
+	seq_step.action = Sequence::End;
+
+	if (onDone)
+		onDone(*this, result, step);
+}
+
+void EvoAll::serviceSequence()
+{
+	while (seq_steps)
+	{
+		if (! seq_step_started)
+		{
+			// load up the next step
+			if (seq_in_flash)
+			{
+				EVOLINK_PGM_READ_BLOCK(&seq_step, &(seq_steps[seq_index]), sizeof(SequenceStep));
+			} else {
+				seq_step = seq_steps[seq_index];
+			}
+
+			seq_step_started = true;
+			seq_step_start = timeMs();
+			seq_msg_seen = false;
+
+			if (seq_step.action == Sequence::End)
+			{
+				finishSequence(Sequence::Completed);
+				return;
+			}
+
+			if (seq_step.action == Sequence::Send)
+			{
+				DataLink::RequestCode reqCode = (DataLink::RequestCode)seq_step.code;
+				if (! queueCommand(reqCode, priorityFor(reqCode), 0, false, true))
+				{
+					finishSequence(Sequence::SendFailed);
+					return;
+				}
+			}
+		}
+
+		uint32_t elapsed = timeMs() - seq_step_start;
+		switch (seq_step.action)
+		{
+		case Sequence::Send:
+			// done once it's actually gone out (or been suppressed)
+			if (sequenceCommandQueued())
+				return;
+			break;
+
+		case Sequence::Delay:
+			if (elapsed < seq_step.ms)
+				return;
+			break;
+
+		case Sequence::WaitFor:
+			if (! seq_msg_seen)
+			{
+				if (seq_step.ms && elapsed >= seq_step.ms)
+					finishSequence(Sequence::TimedOut);
+				return;
+			}
+			break;
+
+		default:
+			// don't know this one, skip it
+			break;
+		}
+
+		// step done, on to the next
+		seq_index++;
+		seq_step_started = false;
+	}
+}
+
+
+
+InputStatus EvoAll::getStatus(uint16_t timeout) {
+	 InputStatus cached = status();
+	 if (cached.valid)
+	 {
+		 // no need to bother the EVO-All
+		 return cached;
+	 }
+
+	 int16_t val = synchronousGet(timeout, DataLink::Request_Input);
+	 if (val < 0)
+	 {
+		 return InputStatus();
+	 }
+
+	 return InputStatus((uint8_t)val);
+
+}
+
+InputStatus EvoAll::status(uint32_t maxAgeMs)
+{
+	InputStatus st = input_cache;
+	st.valid = (input_fields_known == ((1 << Input::NumFields) - 1));
+	if (st.valid && maxAgeMs)
+	{
+		uint32_t timeNow = timeMs();
+		for (uint8_t i=0; i < Input::NumFields; i++)
+		{
+			if ((timeNow - input_update_time[i]) > maxAgeMs)
+			{
+				// stale
+				st.valid = false;
+				break;
+			}
+		}
+	}
+
+	return st;
+}
+
+bool EvoAll::statusAge(Input::Field field, uint32_t & ageMs)
+{
+	if (field >= Input::NumFields || ! (input_fields_known & (1 << field)))
+		return false;
+
+	ageMs = timeMs() - input_update_time[field];
+	return true;
+}
+
+void EvoAll::invalidateStatus()
+{
+	input_fields_known = 0;
+}
+
+/*
+ * RX overruns
+ *
+ * Whatever was lost may well have been a door or brake event, or a
+ * response, so the cached state can't be trusted: forget it, and ask
+ * the EVO-All for the real thing (once--if a resync is already on its
+ * way, it'll do).
+ */
+void EvoAll::checkOverruns()
+{
+	uint16_t count = serial.rxOverruns();
+	if (count == rx_overruns_seen)
+		return;
+
+	uint16_t lost = count - rx_overruns_seen;
+	rx_overruns_seen = count;
+	EVOLINK_STAT(stats.rx_overruns += lost);
+
+	invalidateStatus();
+
+	resync_pending = true;
+	queueResync();
+
+	notifyError(ErrorMessage::RxOverrun, (lost > 0xff) ? 0xff : (uint8_t)lost);
+}
+
+void EvoAll::queueResync()
+{
+	DataRequest * resync = requestFor(resync_request);
+	if (! resync || ! (resync->status == Request::Queued || resync->status == Request::Pending))
+	{
+		resync_request = submitRequest(DataLink::Request_Input,
+				priorityFor(DataLink::Request_Input), 0, NULL, false);
+		if (! resync_request)
+			return; // no room, serviceDeadlines() will try again
+	}
+
+	resync_pending = false;
+}
+
+void EvoAll::updateInputField(Input::Field field, bool set)
+{
+	switch (field)
+	{
+	case Input::Door:
+		input_cache.door = set ? State::Open : State::Closed;
+		break;
+	case Input::Hood:
+		input_cache.hood = set ? State::Open : State::Closed;
+		break;
+	case Input::Trunk:
+		input_cache.trunk = set ? State::Open : State::Closed;
+		break;
+	case Input::Tach:
+		input_cache.tach = set ? State::On : State::Off;
+		break;
+	case Input::HandBrake:
+		input_cache.hand_brake = set ? State::On : State::Off;
+		break;
+	case Input::Brake:
+		input_cache.brake = set ? State::On : State::Off;
+		break;
+	default:
+		return;
+	}
+
+	input_update_time[field] = timeMs();
+	input_fields_known |= (1 << field);
+}
+
+void EvoAll::updateInputCache(uint8_t msgcode)
+{
+	switch (msgcode)
+	{
+	case DataLink::Door_Opened:
+	case DataLink::Door_Closed:
+		updateInputField(Input::Door, msgcode == DataLink::Door_Opened);
+		break;
+	case DataLink::Hood_Opened:
+	case DataLink::Hood_Closed:
+		updateInputField(Input::Hood, msgcode == DataLink::Hood_Opened);
+		break;
+	case DataLink::Trunk_Opened:
+	case DataLink::Trunk_Closed:
+		updateInputField(Input::Trunk, msgcode == DataLink::Trunk_Opened);
+		break;
+	case DataLink::Tach_On:
+	case DataLink::Tach_OverRev:
+	case DataLink::Tach_Off:
+		updateInputField(Input::Tach, msgcode != DataLink::Tach_Off);
+		break;
+	case DataLink::HandBrake_On:
+	case DataLink::HandBrake_Off:
+		updateInputField(Input::HandBrake, msgcode == DataLink::HandBrake_On);
+		break;
+	case DataLink::Brake_On:
+	case DataLink::Brake_Off:
+		updateInputField(Input::Brake, msgcode == DataLink::Brake_On);
+		break;
+	default:
+		break;
+	}
+}
+
+int16_t EvoAll::synchronousGet(uint16_t timeout, DataLink::RequestCode code) {
+
+#ifdef AUTO_CHECKACTIVITY_BEFORE_REQUESTS
+	checkActivity();
+#endif
+
+	// setup our return value, failure as default
+	synch_getter_value_received = -1;
+
+	// we don't notify callbacks.requested_data_received for these
+	RequestHandle handle = submitRequest(code, priorityFor(code), 0, NULL, false);
+	if (handle && waitFor(handle, timeout))
+	{
+		synch_getter_value_received = valueOf(handle);
+		return synch_getter_value_received;
+	}
+
+
+	if (statusOf(handle) == Request::TimedOut)
+	{
+		// already reported
+		return synch_getter_value_received;
+	}
+
+	cancel(handle);
+	EVOLINK_STAT(stats.request_timeouts++);
+	EVOLINK_TRACE(Trace::RequestTimeout, code);
+	notifyError(ErrorMessage::RequestTimeout, code);
+
+	return synch_getter_value_received;
+
+}
+
+/*
+ * Data request handles
+ */
+RequestHandle EvoAll::requestData(DataLink::RequestCode reqCode,
+		RequestCompletionHandler onDone, uint16_t expiresInMs)
+{
+	if (! reqWithResponseEntryFor(reqCode))
+	{
+		// nothing to track, use makeRequest()
+		return RequestHandle();
+	}
+
+#ifdef AUTO_CHECKACTIVITY_BEFORE_REQUESTS
+	checkActivity();
+#endif
+
+	return submitRequest(reqCode, priorityFor(reqCode), expiresInMs, onDone, true);
+}
+
+RequestHandle EvoAll::submitRequest(DataLink::RequestCode reqCode, Priority::Level priority,
+		uint16_t expiresInMs, const RequestCompletionCallback & onDone, bool notifyCallbacks,
+		bool fromSequence)
+{
+	if (num_queued >= EVOLINK_COMMAND_QUEUE_SIZE)
+		return RequestHandle();
+
+	int8_t slot = newRequest(reqCode, onDone, notifyCallbacks);
+	if (slot < 0)
+		return RequestHandle();
+
+	RequestHandle handle(slot, requests[slot].generation);
+	enqueue(reqCode, priority, expiresInMs, slot, fromSequence);
+
+	return handle;
+}
+
+int8_t EvoAll::newRequest(DataLink::RequestCode reqCode, const RequestCompletionCallback & onDone,
+		bool notifyCallbacks)
+{
+	int8_t slot = allocateRequest();
+	if (slot < 0)
+		return -1;
+
+	DataRequest & r = requests[slot];
+	r.req = (uint8_t)reqCode;
+	r.status = Request::Queued;
+	r.generation++;
+	r.notify_callbacks = notifyCallbacks;
+	r.value = -1;
+	r.on_complete = onDone;
+
+	return slot;
+}
+
+int8_t EvoAll::allocateRequest()
+{
+	// round-robin, so the slots of finished requests are
+	// recycled oldest first.
+	for (uint8_t i=0; i < EVOLINK_REQUEST_POOL_SIZE; i++)
+	{
+		uint8_t slot = (next_request_slot + i) % EVOLINK_REQUEST_POOL_SIZE;
+		if (requests[slot].status == Request::Queued || requestInFlight(slot))
+			continue; // busy
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+		if (requests[slot].notify_pending)
+			continue; // handlers yet to hear about it
+#endif
+
+		next_request_slot = (slot + 1) % EVOLINK_REQUEST_POOL_SIZE;
+		return slot;
+	}
+
+	return -1;
+}
+
+EvoAll::DataRequest * EvoAll::requestFor(RequestHandle handle)
+{
+	if (handle.slot >= EVOLINK_REQUEST_POOL_SIZE ||
+			requests[handle.slot].generation != handle.generation)
+	{
+		return NULL;
+	}
+
+	return &(requests[handle.slot]);
+}
+
+void EvoAll::requestSent(uint8_t slot)
+{
+	requests[slot].status = Request::Pending;
+	requests[slot].issue_time = timeMs();
+	inflight[num_inflight++] = slot;
+}
+
+bool EvoAll::requestInFlight(uint8_t slot)
+{
+	for (uint8_t i=0; i < num_inflight; i++)
+	{
+		if (inflight[i] == slot)
+			return true;
+	}
+
+	return false;
+}
+
+void EvoAll::finishRequest(uint8_t slot, Request::Status status, int value)
+{
+	DataRequest & r = requests[slot];
+	for (uint8_t i=0; i < num_inflight; i++)
+	{
+		if (inflight[i] == slot)
+		{
+			num_inflight--;
+			for (uint8_t j=i; j < num_inflight; j++)
+			{
+				inflight[j] = inflight[j + 1];
+			}
+			break;
+		}
+	}
+
+	if (r.status == Request::Cancelled)
+	{
+		// no one cares, any more
+		return;
+	}
+
+	r.status = status;
+	r.value = value;
+
+	EVOLINK_STAT(if (status == Request::Complete) recordLatency(r.req, timeMs() - r.issue_time));
+
+	if (status == Request::Complete && r.req == DataLink::Request_Input)
+	{
+		// refresh the whole cache while we're at it
+		InputStatus st((uint8_t)value);
+		updateInputField(Input::Door, st.door == State::Open);
+		updateInputField(Input::Hood, st.hood == State::Open);
+		updateInputField(Input::Trunk, st.trunk == State::Open);
+		updateInputField(Input::Tach, st.tach == State::On);
+		updateInputField(Input::HandBrake, st.hand_brake == State::On);
+		updateInputField(Input::Brake, st.brake == State::On);
+	}
+
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+	// handlers run from dispatchPending(), not while we're draining the port
+	r.notify_pending = true;
+	deferEvent(Deferred::Response, r.req, value, RequestHandle(slot, r.generation));
+#else
+	notifyCompletion(r);
+#endif
+
+	if (status == Request::TimedOut)
+	{
+		EVOLINK_STAT(stats.request_timeouts++);
+		EVOLINK_TRACE(Trace::RequestTimeout, r.req);
+		notifyError(ErrorMessage::RequestTimeout, r.req);
+	}
+}
+
+void EvoAll::notifyCompletion(DataRequest & r)
+{
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+	r.notify_pending = false;
+#endif
+	if (r.on_complete)
+		r.on_complete(*this, (DataLink::RequestCode)r.req, (Request::Status)r.status, r.value);
+
+	if (r.status == Request::Complete && r.notify_callbacks && callbacks.requested_data_received)
+		callbacks.requested_data_received(*this, (DataLink::RequestCode)r.req, r.value);
+}
+
+Request::Status EvoAll::statusOf(RequestHandle handle)
+{
+	DataRequest * r = requestFor(handle);
+	if (! r)
+		return Request::Expired;
+
+	return (Request::Status)r->status;
+}
+
+int EvoAll::valueOf(RequestHandle handle)
+{
+	DataRequest * r = requestFor(handle);
+	if (! (r && r->status == Request::Complete))
+		return -1;
+
+	return r->value;
+}
+
+bool EvoAll::onComplete(RequestHandle handle, RequestCompletionHandler onDone)
+{
+	return setCompletion(handle, onDone);
+}
+
+bool EvoAll::onComplete(RequestHandle handle,
+		RequestCompletionCallback::ContextFunction onDone, void * context)
+{
+	return setCompletion(handle, RequestCompletionCallback(onDone, context));
+}
+
+bool EvoAll::setCompletion(RequestHandle handle, const RequestCompletionCallback & onDone)
+{
+	DataRequest * r = requestFor(handle);
+	if (! r)
+		return false;
+
+	switch (r->status)
+	{
+	case Request::Queued:
+	case Request::Pending:
+		r->on_complete = onDone;
+		return true;
+
+	case Request::Complete:
+	case Request::TimedOut:
+	case Request::Dropped:
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+		if (r->notify_pending)
+		{
+			// dispatchPending() will let them know
+			r->on_complete = onDone;
+			return true;
+		}
+#endif
+		// already done, let them know right away
+		if (onDone)
+			onDone(*this, (DataLink::RequestCode)r->req, (Request::Status)r->status, r->value);
+		return true;
+
+	default:
+		break;
+	}
+
+	return false;
+}
+
+bool EvoAll::waitFor(RequestHandle handle, uint16_t timeoutMs)
+{
+	uint32_t startTime = timeMs();
+	for (;;)
+	{
+		Request::Status status = statusOf(handle);
+		if (status == Request::Complete)
+			return true;
+
+		if (status != Request::Queued && status != Request::Pending)
+			return false; // not going to happen
+
+		if ((timeMs() - startTime) >= timeoutMs)
+			return false;
+
+		checkActivity();
+		delayMs(1);
+	}
+
+	return false;
+}
+
+void EvoAll::cancel(RequestHandle handle)
+{
+	DataRequest * r = requestFor(handle);
+	if (! r)
+		return;
+
+	if (r->status == Request::Queued)
+	{
+		// pull it from the queue
+		for (uint8_t i=0; i < num_queued; i++)
+		{
+			if (command_queue[i].request_slot == handle.slot)
+			{
+				num_queued--;
+				for (uint8_t j=i; j < num_queued; j++)
+				{
+					command_queue[j] = command_queue[j + 1];
+				}
+				break;
+			}
+		}
+		r->status = Request::Dropped;
+
+	} else if (r->status == Request::Pending)
+	{
+		// still in flight: the response byte will be swallowed when it comes.
+		r->status = Request::Cancelled;
+	}
+}
+
+
+bool EvoAll::sendRequest(DataLink::RequestCode reqCode, bool wasPaced)
+{
+	uint8_t reqCodeV = reqCode;
+	if (serial.write(reqCodeV) != 1)
+		return false; // didn't go out, so nothing to pace or record
+
+	markTransmitted(reqCode, wasPaced);
+	return true;
+}
+
+void EvoAll::noteTransmitted(DataLink::RequestCode reqCode)
+{
+	if (reqWithResponseEntryFor(reqCode) && num_inflight < EVOLINK_MAX_INFLIGHT_REQUESTS)
+	{
+		// its response is on the way
+		int8_t slot = newRequest(reqCode, NULL, true);
+		if (slot >= 0)
+			requestSent(slot);
+	}
+
+	markTransmitted(reqCode, false);
+}
+
+void EvoAll::markTransmitted(DataLink::RequestCode reqCode, bool wasPaced)
+{
+	bool wasAwake = deviceAwake();
+
+	// pacing: whatever comes next must wait at least this long
+	last_tx_time = timeMs();
+	tx_since_begin = true;
+	post_tx_delay_ms = auto_delay_ms;
+	if (reqCode != DataLink::WakeUp)
+		last_command_time = last_tx_time;
+
+#ifdef EVOLINK_COMMAND_SUPPRESSION_ENABLE
+	// the output is now as commanded
+	uint8_t outputEntry = outputEntryFor(reqCode);
+	if (outputEntry != EVOLINK_NO_TABLE_ENTRY)
+		recordOutput(outputEntry);
+#endif
+
+#ifdef POSTWAKEUP_AUTO_DELAY_MS
+	// (only needed if it was actually asleep)
+	if (reqCode == DataLink::WakeUp && ! wasAwake && post_tx_delay_ms < POSTWAKEUP_AUTO_DELAY_MS)
+		post_tx_delay_ms = POSTWAKEUP_AUTO_DELAY_MS;
+#endif
+
+#ifdef POSTGROUNDOUT_ON_DELAY_MS
+	if (reqCode == DataLink::GroundOut_On && post_tx_delay_ms < POSTGROUNDOUT_ON_DELAY_MS)
+		post_tx_delay_ms = POSTGROUNDOUT_ON_DELAY_MS;
+#endif
+
+	(void)wasPaced; // only traced
+	EVOLINK_TRACE(wasPaced ? Trace::AutoDelay : Trace::Sent, reqCode);
+	EVOLINK_STAT(stats.bytes_tx++);
+	EVOLINK_STAT(if (reqCode != DataLink::WakeUp) stats.commands_tx++);
 }
 
 
@@ -828,7 +2375,7 @@ bool EvoAll::horn(Horn::Action act)
 		hornReq = DataLink::Horn_Off;
 		break;
 	case Horn::On:
-		hornReq = DataLink::Horn_Off;
+		hornReq = DataLink::Horn_On;
 		break;
 
 	case Horn::Beep15ms:
@@ -870,53 +2417,15 @@ bool EvoAll::auxiliary(uint8_t index)
 	return makeRequest(idxToCode[index - 1]);
 
 }
-EvoAll::RequestWithResponse * EvoAll::reqWithResponseEntryFor(DataLink::RequestCode code)
+const EvoAll::RequestWithResponse * EvoAll::reqWithResponseEntryFor(DataLink::RequestCode code)
 {
-	uint8_t i=0;
-	do {
-		if (reqs_with_responses[i].req == code)
-		{
-			//found it!
-			return &(reqs_with_responses[i]);
-		}
-	} while (reqs_with_responses[i++].req != DataLink::Request_Temperature);
+	static_assert(DispatchTables::requestsUnique(), "duplicate entry in reqs_with_responses[]");
 
-	return NULL;
+	uint8_t idx = EVOLINK_PGM_READ_BYTE(&(DispatchTables::request_index[(uint8_t)code]));
+	if (idx == EVOLINK_NO_TABLE_ENTRY)
+		return NULL;
 
-}
-void EvoAll::resetPendingRequest()
-{
-	pending_request_response = NULL;
+	return &(DispatchTables::reqs_with_responses[idx]);
 
 }
-void EvoAll::prepareRequestNeedingResponse(EvoAll::RequestWithResponse * setup)
-{
-#ifdef DEBUG_USART_ENABLE
-	if (serial_setup.debug_usart)
-	{
-		serial_setup.debug_usart->print(F("Evo expects response"));
-	}
-#endif
-	pending_request_response = setup;
-	pending_request_issue_time = timeMs();
-
-}
-
-void EvoAll::synchronousValueGetterSetup() {
-
-	// backup user-specified handler
-	user_specified_handler = callbacks.requested_data_received;
-
-	// setup our own handler
-	callbacks.requested_data_received = synchronous_getter_handler;
-
-	// setup our return value, failure as default
-	synch_getter_value_received = -1;
-}
-
-void EvoAll::synchronousValueGetterTeardown() {
-	// restore the user specified handler
-	callbacks.requested_data_received = user_specified_handler;
-}
-
 } /* namespace EvoLink */
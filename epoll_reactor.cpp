@@ -0,0 +1,282 @@
+/*
+ * epoll_reactor.cpp -- Multi-link event loop for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "includes/reactor/epoll_reactor.h"
+
+#if defined(PLATFORM_POSIX) && defined(__linux__)
+
+#include <sys/epoll.h>
+
+// max number of epoll events handled per runOnce()
+#define EVOLINK_REACTOR_MAX_EVENTS		64
+
+namespace EvoLink {
+
+Reactor::Reactor(uint16_t max_links) :
+		epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+		capacity(max_links),
+		num_links(0),
+		links(new ReactorLink[max_links]),
+		heap(new uint16_t[max_links]),
+		heap_size(0)
+{
+	for (uint16_t i=0; i < capacity; i++)
+	{
+		links[i].link = NULL;
+		links[i].deadline = 0;
+		links[i].heap_pos = -1;
+	}
+}
+
+Reactor::~Reactor()
+{
+	if (epoll_fd >= 0)
+		close(epoll_fd);
+
+	delete [] links;
+	delete [] heap;
+}
+
+int16_t Reactor::slotFor(EvoAll * link)
+{
+	for (uint16_t i=0; i < capacity; i++)
+	{
+		if (links[i].link == link)
+			return i;
+	}
+
+	return -1;
+}
+
+bool Reactor::add(EvoAll * link)
+{
+	if (epoll_fd < 0 || link == NULL || link->serialPort() < 0)
+		return false;
+
+	int16_t slot = slotFor(NULL);
+	if (slot < 0)
+		return false; // full
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = (uint32_t)slot;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, link->serialPort(), &ev) != 0)
+		return false;
+
+	links[slot].link = link;
+	links[slot].heap_pos = -1;
+	num_links++;
+
+	updateSchedule(slot);
+	return true;
+}
+
+bool Reactor::remove(EvoAll * link)
+{
+	if (link == NULL)
+		return false;
+
+	int16_t slot = slotFor(link);
+	if (slot < 0)
+		return false;
+
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, link->serialPort(), NULL);
+	heapRemove(slot);
+	links[slot].link = NULL;
+	num_links--;
+
+	return true;
+}
+
+void Reactor::reschedule(EvoAll * link)
+{
+	int16_t slot = slotFor(link);
+	if (slot >= 0)
+		updateSchedule(slot);
+}
+
+uint16_t Reactor::runOnce(int max_wait_ms)
+{
+	int timeout = max_wait_ms;
+	if (heap_size)
+	{
+		int32_t untilNext = (int32_t)(links[heap[0]].deadline - timeMs());
+		if (untilNext < 0)
+			untilNext = 0;
+
+		if (timeout < 0 || untilNext < timeout)
+			timeout = untilNext;
+	}
+
+	struct epoll_event events[EVOLINK_REACTOR_MAX_EVENTS];
+	int numEvents = epoll_wait(epoll_fd, events, EVOLINK_REACTOR_MAX_EVENTS, timeout);
+
+	uint16_t numServiced = 0;
+	for (int i=0; i < numEvents; i++)
+	{
+		uint16_t slot = (uint16_t)events[i].data.u32;
+		EvoAll * link = links[slot].link;
+		if (! link)
+			continue;
+
+		uint16_t numRead = link->processIncoming();
+		if ((! numRead) && (events[i].events & (EPOLLHUP | EPOLLERR)))
+		{
+			// other side is gone, stop watching it (or we'd spin)
+			remove(link);
+			continue;
+		}
+
+		// its callbacks may have removed it
+		if (links[slot].link == link)
+			updateSchedule(slot);
+		numServiced++;
+	}
+
+	// now whatever's come due.  Each link is serviced at most
+	// once per pass, even if it reschedules itself in the past.
+	uint32_t timeNow = timeMs();
+	uint16_t maxDue = heap_size;
+	while (maxDue-- && heap_size &&
+			((int32_t)(links[heap[0]].deadline - timeNow) <= 0))
+	{
+		uint16_t slot = heap[0];
+		heapRemove(slot);
+		links[slot].link->serviceDeadlines();
+		if (links[slot].link)
+			updateSchedule(slot);
+		numServiced++;
+	}
+
+	return numServiced;
+}
+
+void Reactor::updateSchedule(uint16_t slot)
+{
+	EvoAll * link = links[slot].link;
+	uint32_t deadline;
+	if (! (link && link->nextDeadline(deadline)))
+	{
+		heapRemove(slot);
+		return;
+	}
+
+	// the link's deadline is on its own clock, but we wait in real
+	// time: keep how far off it is, from now on our timeMs().
+	int32_t untilDue = (int32_t)(deadline - link->clock().nowMs());
+	if (untilDue < 0)
+		untilDue = 0;
+
+	links[slot].deadline = timeMs() + (uint32_t)untilDue;
+	if (links[slot].heap_pos < 0)
+	{
+		// new entry, at the bottom
+		links[slot].heap_pos = heap_size;
+		heap[heap_size++] = slot;
+	}
+
+	heapUp(links[slot].heap_pos);
+	heapDown(links[slot].heap_pos);
+}
+
+/*
+ * Deadline min-heap.  Deadlines are compared relative to one another
+ * so that the timeMs() wrap-around is a non-issue.
+ */
+bool Reactor::earlier(uint16_t slotA, uint16_t slotB)
+{
+	return ((int32_t)(links[slotA].deadline - links[slotB].deadline) < 0);
+}
+
+void Reactor::heapSwap(uint16_t posA, uint16_t posB)
+{
+	uint16_t tmp = heap[posA];
+	heap[posA] = heap[posB];
+	heap[posB] = tmp;
+
+	links[heap[posA]].heap_pos = posA;
+	links[heap[posB]].heap_pos = posB;
+}
+
+void Reactor::heapUp(uint16_t pos)
+{
+	while (pos)
+	{
+		uint16_t parent = (pos - 1) / 2;
+		if (! earlier(heap[pos], heap[parent]))
+			return;
+
+		heapSwap(pos, parent);
+		pos = parent;
+	}
+}
+
+void Reactor::heapDown(uint16_t pos)
+{
+	for (;;)
+	{
+		uint16_t smallest = pos;
+		uint16_t left = (2 * pos) + 1;
+		uint16_t right = left + 1;
+
+		if (left < heap_size && earlier(heap[left], heap[smallest]))
+			smallest = left;
+		if (right < heap_size && earlier(heap[right], heap[smallest]))
+			smallest = right;
+
+		if (smallest == pos)
+			return;
+
+		heapSwap(pos, smallest);
+		pos = smallest;
+	}
+}
+
+void Reactor::heapRemove(uint16_t slot)
+{
+	int32_t pos = links[slot].heap_pos;
+	if (pos < 0)
+		return; // not scheduled
+
+	heap_size--;
+	if ((uint16_t)pos != heap_size)
+	{
+		heapSwap(pos, heap_size);
+		heapUp(pos);
+		heapDown(pos);
+	}
+
+	links[slot].heap_pos = -1;
+}
+
+} /* namespace EvoLink */
+
+#endif /* PLATFORM_POSIX && __linux__ */
+
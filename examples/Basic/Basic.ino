@@ -65,7 +65,9 @@ void loop()
     EVO.starterKillOn();
     EVO.systemArm();
     EVO.lock();
-    delay(750); // wait a bit
+    // wait a bit -- commands are queued and sent as the EVO-All
+    // can take them, so don't use a plain delay() here.
+    EVO.delayWhileCheckingActivity(750);
     EVO.parklightOff();
 
   } else {
@@ -77,9 +79,9 @@ void loop()
     EVO.systemDisarm();
     EVO.unlock();
     EVO.parklightOff();
-    delay(250);
+    EVO.delayWhileCheckingActivity(250);
     EVO.parklightOn();
-    delay(250);
+    EVO.delayWhileCheckingActivity(250);
     EVO.parklightOff();
   }
 
@@ -148,6 +148,10 @@ void setup()
 
   DEBUG_SERIAL.println(F("Setup complete -- will now monitor events..."));
 
+  // what the link costs in RAM, given the options set in config.h
+  DEBUG_SERIAL.print(F("EvoAll RAM (bytes): "));
+  DEBUG_SERIAL.println(sizeof(EVO));
+
 }
 
 
@@ -252,6 +252,10 @@ void misc_message_received(DataLink::MessageCode message) {
  *
  * int16_t temp = EVO.getTemperature();
  *
+ * Finally, the requestXXX() methods return a RequestHandle, which you may poll
+ * (EVO.statusOf(h), EVO.valueOf(h)), wait on (EVO.waitFor(h, ms)) or attach
+ * a completion handler to (EVO.onComplete(h, handler)).
+ *
  * See the docs for details.
  *
  */
@@ -320,6 +324,11 @@ void error_event(ErrorMessage::Event event, uint8_t more_info) {
       DEBUG_SERIAL.print(F("ERROR: Timeout for request -- "));
       DEBUG_SERIAL.println(more_info, HEX);
 
+      break;
+    case ErrorMessage::RxOverrun:
+      // some incoming bytes were lost: EvoLink will resync the input states
+      DEBUG_SERIAL.print(F("ERROR: Receive overrun(s) -- "));
+      DEBUG_SERIAL.println(more_info, DEC);
       break;
     case ErrorMessage::Temperature_Error:
       DEBUG_SERIAL.println(F("ERROR: Temp read error or no thermo present"));
@@ -0,0 +1,150 @@
+/*
+ * bulk_read.cpp -- Receive path benchmark for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Receive path benchmark, for Linux.
+ *
+ * Fills a pseudo-terminal with event bytes and measures how fast the
+ * driver gets through them, either one byte at a time (available(),
+ * read(), parseMessage() for every byte--the way checkActivity() used
+ * to do it) or in bulk (SerialConnection::readBytes() and
+ * parseMessages(), as processIncoming() does now).
+ *
+ * Build, from the library root:
+ *
+ * 	g++ -O2 -std=gnu++11 -I. *.cpp extras/bench/bulk_read.cpp -o bulk_read
+ *
+ * Run:
+ * 	./bulk_read [total MB, default 4]
+ *
+ */
+
+#include "EvoLink.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace EvoLink;
+
+#define FILL_BLOCK_SIZE		2048
+
+static uint32_t num_events = 0;
+
+static void event_received(OpenClose::Event event)
+{
+	num_events++;
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void write_all(int fd, const uint8_t * buf, size_t len)
+{
+	while (len)
+	{
+		ssize_t w = write(fd, buf, len);
+		if (w <= 0)
+		{
+			perror("write");
+			exit(1);
+		}
+		buf += w;
+		len -= w;
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	double megs = (argc > 1) ? atof(argv[1]) : 4.0;
+	size_t total = (size_t)(megs * 1024 * 1024);
+
+	int m = posix_openpt(O_RDWR | O_NOCTTY);
+	if (m < 0 || grantpt(m) || unlockpt(m))
+	{
+		perror("pty");
+		return 1;
+	}
+
+	EvoAll link;
+	link.callbacks.openclose_event = event_received;
+	link.setAutoDelayMs(0);
+	link.begin(SerialSetup(ptsname(m)));
+
+	// second connection on the same port, to emulate the per-byte path
+	SerialSetup perByteSetup(link.serialPort(), BAUDRATE_DEFAULT, false);
+	SerialConnection perByte;
+	perByte.setup(perByteSetup);
+
+	uint8_t block[FILL_BLOCK_SIZE];
+	for (size_t i=0; i < FILL_BLOCK_SIZE; i++)
+		block[i] = (i & 1) ? MSG_DOOR_CLOSED : MSG_DOOR_OPENED;
+
+	printf("%-10s %12s %12s\n", "path", "bytes", "MB/s");
+	for (uint8_t bulk=0; bulk < 2; bulk++)
+	{
+		uint64_t spent = 0;
+		size_t done = 0;
+		num_events = 0;
+		while (done < total)
+		{
+			write_all(m, block, FILL_BLOCK_SIZE);
+			tcdrain(m);
+
+			uint64_t start = now_ns();
+			size_t got = 0;
+			while (got < FILL_BLOCK_SIZE)
+			{
+				if (bulk)
+				{
+					got += link.processIncoming();
+				} else {
+					while (perByte.available())
+					{
+						link.parseMessage(perByte.read());
+						got++;
+					}
+				}
+			}
+			spent += now_ns() - start;
+			done += got;
+		}
+
+		printf("%-10s %12zu %12.2f\n", bulk ? "bulk" : "per-byte", done,
+				(done / (1024.0 * 1024.0)) / (spent / 1e9));
+		if (num_events != done)
+			printf("  (dispatched %u events?)\n", num_events);
+	}
+
+	close(m);
+	return 0;
+}
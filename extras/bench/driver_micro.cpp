@@ -0,0 +1,343 @@
+/*
+ * driver_micro.cpp -- Driver microbenchmarks for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Driver microbenchmarks, for Linux.
+ *
+ * Runs the driver against in-memory stand-ins--no tty, no EVO-All--on a
+ * VirtualClock (so pacing, wake-up tracking and timeouts never wait on
+ * real time), and measures:
+ *
+ *  - parse:    parseMessages() throughput, per message family (plus
+ *              unsupported codes, which go to the error callback);
+ *  - lookup:   handlerForMessage() cost;
+ *  - request:  makeRequest() cost for a command, with pacing disabled,
+ *              from the queue through sendRequest() (the link writes
+ *              to /dev/null, so the byte itself goes nowhere), and a data
+ *              request round trip (requestTach() + its response);
+ *  - latency:  event-to-callback latency, from the byte being handed
+ *              over to the callback running: in memory (parseMessage())
+ *              and through a socketpair() (write(), then processIncoming()).
+ *
+ * Output is one JSON object per line, so results can be collected and
+ * compared across releases:
+ *
+ * 	{"bench":"parse","case":"open_close","iterations":...,"ns_per_op":...,"mops":...}
+ * 	{"bench":"latency","case":"socketpair","samples":...,"p50_ns":...,"p99_ns":...,"max_ns":...}
+ *
+ * Build, from the library root:
+ *
+ * 	g++ -O2 -std=gnu++11 -I. *.cpp extras/bench/driver_micro.cpp -o driver_micro
+ *
+ * Run:
+ * 	./driver_micro [scale, default 1]
+ *
+ */
+
+#include "EvoLink.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+using namespace EvoLink;
+
+#define PARSE_BUFFER_SIZE		4096
+#define LATENCY_SAMPLES			20000
+
+static volatile uint32_t num_callbacks = 0;
+static uint64_t callback_ns = 0;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void remotestarter_event(RemoteStarter::Event) { num_callbacks++; }
+static void openclose_event(OpenClose::Event) { num_callbacks++; }
+static void brake_event(Brake::Event) { num_callbacks++; }
+static void sensor_event(Sensor::Event) { num_callbacks++; }
+static void tach_event(Tach::Event) { num_callbacks++; }
+static void message_received(DataLink::MessageCode) { num_callbacks++; }
+static void error_event(ErrorMessage::Event, uint8_t) { num_callbacks++; }
+static void data_received(DataLink::RequestCode, int) { num_callbacks++; }
+
+static void latency_event(OpenClose::Event)
+{
+	callback_ns = now_ns();
+	num_callbacks++;
+}
+
+static void setup_link(EvoAll & link, VirtualClock & clock)
+{
+	link.setClock(clock);
+	link.setAutoDelayMs(0);
+	link.callbacks.remotestarter_event = remotestarter_event;
+	link.callbacks.openclose_event = openclose_event;
+	link.callbacks.brake_event = brake_event;
+	link.callbacks.sensor_event = sensor_event;
+	link.callbacks.tach_event = tach_event;
+	link.callbacks.message_received = message_received;
+	link.callbacks.error_event = error_event;
+	link.callbacks.requested_data_received = data_received;
+}
+
+static void report(const char * bench, const char * which, uint64_t iterations, uint64_t ns)
+{
+	double nsPerOp = (double)ns / iterations;
+	printf("{\"bench\":\"%s\",\"case\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"mops\":%.2f}\n",
+			bench, which, (unsigned long long)iterations, nsPerOp, 1000.0 / nsPerOp);
+}
+
+static int compare_u64(const void * a, const void * b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static void report_latency(const char * which, uint64_t * samples, uint32_t num)
+{
+	qsort(samples, num, sizeof(uint64_t), compare_u64);
+	printf("{\"bench\":\"latency\",\"case\":\"%s\",\"samples\":%u,\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}\n",
+			which, num, (unsigned long long)samples[num / 2],
+			(unsigned long long)samples[(num * 99) / 100],
+			(unsigned long long)samples[num - 1]);
+}
+
+/*
+ * parseMessages() throughput, per family
+ */
+typedef struct FamilyCodesStruct {
+	const char * name;
+	uint8_t codes[6];
+	uint8_t num_codes;
+} FamilyCodes;
+
+static const FamilyCodes families[] = {
+	{"remote_starter", {MSG_REMOTESTARTER_ARM, MSG_REMOTESTARTER_DISARM,
+			MSG_REMOTESTARTER_ON, MSG_REMOTESTARTER_OFF}, 4},
+	{"open_close", {MSG_DOOR_OPENED, MSG_DOOR_CLOSED, MSG_HOOD_OPENED,
+			MSG_HOOD_CLOSED, MSG_TRUNK_OPENED, MSG_TRUNK_CLOSED}, 6},
+	{"brake", {MSG_BRAKE_ON, MSG_BRAKE_OFF, MSG_HANDBRAKE_ON, MSG_HANDBRAKE_OFF}, 4},
+	{"sensor", {DataLink::ShockSensor_Trigger, DataLink::AlarmSensor_PreWarn,
+			DataLink::TiltSensor_Trigger, DataLink::VSS_Over_15MPH}, 4},
+	{"tach", {MSG_TACH_ON, MSG_TACH_OFF, DataLink::Tach_OverRev}, 3},
+	{"generic", {MSG_PING, MSG_PONG, DataLink::CarKey_In_On, DataLink::CarKey_In_Off}, 4},
+	{"unsupported", {0x00, 0x01, 0x02, 0xfe}, 4},
+};
+
+static void bench_parse(uint32_t scale)
+{
+	VirtualClock clock;
+	EvoAll link;
+	setup_link(link, clock);
+
+	uint8_t buf[PARSE_BUFFER_SIZE];
+	uint32_t rounds = 500 * scale;
+	for (uint8_t f=0; f < sizeof(families) / sizeof(families[0]); f++)
+	{
+		for (uint16_t i=0; i < PARSE_BUFFER_SIZE; i++)
+			buf[i] = families[f].codes[i % families[f].num_codes];
+
+		num_callbacks = 0;
+		uint64_t start = now_ns();
+		for (uint32_t r=0; r < rounds; r++)
+			link.parseMessages(buf, PARSE_BUFFER_SIZE);
+		uint64_t spent = now_ns() - start;
+
+		if (num_callbacks != rounds * PARSE_BUFFER_SIZE)
+		{
+			fprintf(stderr, "parse %s: %u callbacks, expected %u\n", families[f].name,
+					(unsigned)num_callbacks, rounds * PARSE_BUFFER_SIZE);
+			exit(1);
+		}
+		report("parse", families[f].name, (uint64_t)rounds * PARSE_BUFFER_SIZE, spent);
+	}
+}
+
+/*
+ * handlerForMessage()
+ */
+static void bench_lookup(uint32_t scale)
+{
+	EvoAll link;
+	link.setHandlerForMessage(DataLink::Door_Opened, message_received);
+
+	uint32_t iterations = 20000000UL * scale;
+	uint32_t found = 0;
+	uint64_t start = now_ns();
+	for (uint32_t i=0; i < iterations; i++)
+	{
+		if (link.handlerForMessage((uint8_t)i))
+			found++;
+		__asm__ __volatile__("" ::: "memory");
+	}
+	uint64_t spent = now_ns() - start;
+
+	if (found != iterations / 256)
+	{
+		fprintf(stderr, "lookup: found %u\n", found);
+		exit(1);
+	}
+	report("lookup", "handler_for_message", iterations, spent);
+}
+
+/*
+ * makeRequest() & co.
+ */
+static void bench_requests(uint32_t scale)
+{
+	VirtualClock clock;
+	EvoAll link;
+	setup_link(link, clock);
+
+	// the bytes must go somewhere, or they'd stay queued, and time
+	// stands still, so no post wake-up delays either.
+	int sink = open("/dev/null", O_WRONLY);
+	link.begin(SerialSetup(sink, BAUDRATE_DEFAULT, false));
+	link.setAutoWakeUp(false);
+
+	// commands: queued, then straight out through sendRequest()
+	uint32_t iterations = 2000000UL * scale;
+	uint64_t start = now_ns();
+	uint32_t failed = 0;
+	for (uint32_t i=0; i < iterations; i++)
+	{
+		if (! link.makeRequest((i & 1) ? DataLink::Driver1_Unlock : DataLink::Driver1_Lock))
+			failed++;
+	}
+	uint64_t spent = now_ns() - start;
+
+	if (failed)
+	{
+		fprintf(stderr, "request: %u commands refused\n", (unsigned)failed);
+		exit(1);
+	}
+	report("request", "make_request_command", iterations, spent);
+
+	// data request, plus its response coming back
+	num_callbacks = 0;
+	start = now_ns();
+	for (uint32_t i=0; i < iterations; i++)
+	{
+		link.requestTach();
+		link.parseMessage(0x20);
+	}
+	spent = now_ns() - start;
+
+	if (num_callbacks != iterations)
+	{
+		fprintf(stderr, "request: %u responses, expected %u\n", (unsigned)num_callbacks, iterations);
+		exit(1);
+	}
+	report("request", "data_request_roundtrip", iterations, spent);
+
+	link.end();
+	close(sink);
+}
+
+/*
+ * event to callback
+ */
+static void bench_latency(uint32_t scale)
+{
+	uint32_t num = LATENCY_SAMPLES * scale;
+	uint64_t * samples = new uint64_t[num];
+
+	// in memory
+	{
+		VirtualClock clock;
+		EvoAll link;
+		setup_link(link, clock);
+		link.callbacks.openclose_event = latency_event;
+
+		for (uint32_t i=0; i < num; i++)
+		{
+			uint64_t sent = now_ns();
+			link.parseMessage((i & 1) ? MSG_DOOR_CLOSED : MSG_DOOR_OPENED);
+			samples[i] = callback_ns - sent;
+		}
+		report_latency("memory", samples, num);
+	}
+
+	// through a socketpair, as from a tty
+	{
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+		{
+			perror("socketpair");
+			exit(1);
+		}
+
+		VirtualClock clock;
+		EvoAll link;
+		setup_link(link, clock);
+		link.callbacks.openclose_event = latency_event;
+
+		link.begin(SerialSetup(fds[0], BAUDRATE_DEFAULT, false));
+
+		for (uint32_t i=0; i < num; i++)
+		{
+			uint8_t b = (i & 1) ? MSG_DOOR_CLOSED : MSG_DOOR_OPENED;
+			uint32_t before = num_callbacks;
+			uint64_t sent = now_ns();
+			if (write(fds[1], &b, 1) != 1)
+			{
+				perror("write");
+				exit(1);
+			}
+			while (num_callbacks == before)
+				link.processIncoming();
+			samples[i] = callback_ns - sent;
+		}
+		report_latency("socketpair", samples, num);
+
+		close(fds[0]);
+		close(fds[1]);
+	}
+
+	delete [] samples;
+}
+
+int main(int argc, char * argv[])
+{
+	uint32_t scale = (argc > 1) ? atoi(argv[1]) : 1;
+	if (! scale)
+		scale = 1;
+
+	bench_parse(scale);
+	bench_lookup(scale);
+	bench_requests(scale);
+	bench_latency(scale);
+
+	return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * event_fanout.cpp -- Event bus fan-out benchmark for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Event fan-out benchmark, for Linux.
+ *
+ * Compares the cost of getting an event to its handlers through today's
+ * single callback (callbacks.openclose_event) with the event bus
+ * (EvoAll::subscribe()), with the event going out to 1, 2, 4 and 8
+ * subscribers, and with 8 subscribers of which only one wants it (i.e.
+ * the cost of those that don't).  The link is never begun and runs on a
+ * VirtualClock, so this is just parseMessage() and dispatch.
+ *
+ * Output is one JSON object per line, as for driver_micro:
+ *
+ * 	{"bench":"fanout","case":"bus_4_of_4","iterations":...,"ns_per_op":...,"mops":...}
+ *
+ * where ns_per_op is per event (not per handler call).
+ *
+ * Build, from the library root:
+ *
+ * 	g++ -O2 -std=gnu++11 -DEVOLINK_EVENT_BUS_ENABLE -DEVOLINK_MAX_SUBSCRIBERS=8 \
+ * 		-I. *.cpp extras/bench/event_fanout.cpp -o event_fanout
+ *
+ * Run:
+ * 	./event_fanout [scale, default 1]
+ *
+ */
+
+#include "EvoLink.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(EVOLINK_EVENT_BUS_ENABLE) || EVOLINK_MAX_SUBSCRIBERS < 8
+#error "build with -DEVOLINK_EVENT_BUS_ENABLE -DEVOLINK_MAX_SUBSCRIBERS=8"
+#endif
+
+using namespace EvoLink;
+
+#define NUM_EVENTS		1000000UL
+
+static volatile uint32_t num_calls = 0;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void openclose_event(OpenClose::Event) { num_calls++; }
+static void subscriber(DataLink::MessageCode) { num_calls++; }
+
+static void run(const char * which, EvoAll & link, uint32_t events, uint32_t expectedCalls)
+{
+	num_calls = 0;
+	uint64_t start = now_ns();
+	for (uint32_t i=0; i < events; i++)
+		link.parseMessage((i & 1) ? MSG_DOOR_CLOSED : MSG_DOOR_OPENED);
+	uint64_t spent = now_ns() - start;
+
+	if (num_calls != expectedCalls)
+	{
+		fprintf(stderr, "%s: %u calls, expected %u\n", which, (unsigned)num_calls,
+				(unsigned)expectedCalls);
+		exit(1);
+	}
+
+	double nsPerOp = (double)spent / events;
+	printf("{\"bench\":\"fanout\",\"case\":\"%s\",\"iterations\":%u,\"ns_per_op\":%.2f,\"mops\":%.2f}\n",
+			which, (unsigned)events, nsPerOp, 1000.0 / nsPerOp);
+}
+
+int main(int argc, char * argv[])
+{
+	uint32_t scale = (argc > 1) ? atoi(argv[1]) : 1;
+	if (! scale)
+		scale = 1;
+	uint32_t events = NUM_EVENTS * scale;
+
+	MessageMask doors;
+	doors.add(DataLink::Door_Opened).add(DataLink::Door_Closed);
+	MessageMask brakes;
+	brakes.add(DataLink::Brake_On).add(DataLink::Brake_Off);
+
+	VirtualClock clock;
+
+	{
+		EvoAll link;
+		link.setClock(clock);
+		link.callbacks.openclose_event = openclose_event;
+		run("single_callback", link, events, events);
+	}
+
+	static const uint8_t fanouts[] = {1, 2, 4, 8};
+	for (uint8_t f=0; f < sizeof(fanouts) / sizeof(fanouts[0]); f++)
+	{
+		EvoAll link;
+		link.setClock(clock);
+		for (uint8_t s=0; s < fanouts[f]; s++)
+			link.subscribe(doors, subscriber);
+
+		char which[32];
+		snprintf(which, sizeof(which), "bus_%u_of_%u", fanouts[f], fanouts[f]);
+		run(which, link, events, events * fanouts[f]);
+	}
+
+	{
+		EvoAll link;
+		link.setClock(clock);
+		link.subscribe(doors, subscriber);
+		for (uint8_t s=1; s < 8; s++)
+			link.subscribe(brakes, subscriber);
+		run("bus_1_of_8", link, events, events);
+	}
+
+	return 0;
+}
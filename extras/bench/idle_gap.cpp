@@ -0,0 +1,247 @@
+/*
+ * idle_gap.cpp -- Inter-byte idle detection benchmark for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Inter-byte idle detection benchmark, for Linux.
+ *
+ * A writer thread plays the EVO-All's side of a pseudo-terminal, sending
+ * bursts of event bytes spaced as they would be on a real line at the
+ * given baud rate (8N1).  For each burst, the main thread sits in
+ * checkActivity(timeout) and we note:
+ *
+ *  - latency: from the moment the last byte of the burst was written,
+ *    to checkActivity() returning (i.e. how long it takes to decide the
+ *    line has gone idle);
+ *  - throughput: burst bytes over the time from first byte written to
+ *    return, as a percentage of the wire's own rate.
+ *
+ * This is done for the current, baud-aware checkActivity(), and for a
+ * copy of the older loop, which assumed 9600 baud (950us after every
+ * emptied buffer, 500us naps while waiting).
+ *
+ * Build, from the library root:
+ *
+ * 	g++ -O2 -std=gnu++11 -I. *.cpp extras/bench/idle_gap.cpp -o idle_gap -lpthread
+ *
+ * Run:
+ * 	./idle_gap [bursts per test, default 100]
+ *
+ * Output is one line per (baud, burst size, loop), whitespace separated.
+ *
+ */
+
+#include "EvoLink.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace EvoLink;
+
+#define MAX_BURST		32
+
+static int master_fd = -1;
+static uint32_t num_events = 0;
+
+// writer thread state
+static volatile uint32_t burst_baud = 0;
+static volatile uint8_t burst_len = 0;		// set to start a burst, cleared when done
+static volatile uint64_t burst_first_ns = 0;
+static volatile uint64_t burst_last_ns = 0;
+
+static void event_received(OpenClose::Event event)
+{
+	num_events++;
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t t)
+{
+	struct timespec ts;
+	ts.tv_sec = t / 1000000000ULL;
+	ts.tv_nsec = t % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+static void * wire_writer(void *)
+{
+	for (;;)
+	{
+		uint8_t len = __atomic_load_n(&burst_len, __ATOMIC_ACQUIRE);
+		if (! len)
+		{
+			sleep_until_ns(now_ns() + 20000);
+			continue;
+		}
+
+		// start at some random point after the reader is waiting
+		uint64_t charNs = (10ULL * 1000000000ULL) / burst_baud;
+		uint64_t t = now_ns() + 500000 + (rand() % 1500000);
+		for (uint8_t i=0; i < len; i++)
+		{
+			sleep_until_ns(t);
+			uint8_t b = (i & 1) ? MSG_DOOR_CLOSED : MSG_DOOR_OPENED;
+			if (write(master_fd, &b, 1) != 1)
+			{
+				perror("write");
+				exit(1);
+			}
+
+			uint64_t sent = now_ns();
+			if (! i)
+				burst_first_ns = sent;
+			burst_last_ns = sent;
+			t += charNs;
+		}
+
+		__atomic_store_n(&burst_len, 0, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+// the checkActivity() loop as it was, assuming 9600 baud
+static void legacy_check_activity(EvoAll & link, uint16_t timeout)
+{
+	bool msgRcvd = false;
+	uint32_t maxMs = (timeMs() + (uint32_t)timeout);
+	int fd = link.serialPort();
+
+	uint8_t buf[EVOLINK_RX_CHUNK_SIZE];
+	ssize_t numRead;
+	do {
+		link.serviceDeadlines();
+
+		while ((numRead = read(fd, buf, EVOLINK_RX_CHUNK_SIZE)) > 0)
+		{
+			if (link.parseMessages(buf, numRead))
+				msgRcvd = true;
+
+			int avail = 0;
+			ioctl(fd, FIONREAD, &avail);
+			if (! avail)
+				delayUs(950);
+		}
+
+		if (timeout)
+			delayUs(500);
+
+	} while ((!msgRcvd) && (maxMs > timeMs()));
+}
+
+static int compare_u64(const void * a, const void * b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static void run(EvoAll & link, uint32_t baud, uint8_t len, bool legacy, uint16_t rounds)
+{
+	uint64_t * latencies = new uint64_t[rounds];
+	double throughputPct = 0;
+
+	burst_baud = baud;
+	for (uint16_t r=0; r < rounds; r++)
+	{
+		num_events = 0;
+		__atomic_store_n(&burst_len, len, __ATOMIC_RELEASE);
+
+		// wait out the whole burst
+		uint64_t returned = 0;
+		do {
+			if (legacy)
+				legacy_check_activity(link, 100);
+			else
+				link.checkActivity(100);
+			returned = now_ns();
+		} while (num_events < len);
+
+		while (__atomic_load_n(&burst_len, __ATOMIC_ACQUIRE))
+			; // writer's bookkeeping
+
+		latencies[r] = returned - burst_last_ns;
+		uint64_t wireNs = (len * 10ULL * 1000000000ULL) / baud;
+		throughputPct += (100.0 * wireNs) / (returned - burst_first_ns + (wireNs / len));
+	}
+
+	qsort(latencies, rounds, sizeof(uint64_t), compare_u64);
+	printf("%-8u %-6u %-8s %10.1f %10.1f %10.1f %8.1f\n", baud, len,
+			legacy ? "fixed" : "baud", latencies[rounds / 2] / 1000.0,
+			latencies[(rounds * 99) / 100] / 1000.0,
+			latencies[rounds - 1] / 1000.0, throughputPct / rounds);
+
+	delete [] latencies;
+}
+
+int main(int argc, char * argv[])
+{
+	uint16_t rounds = (argc > 1) ? atoi(argv[1]) : 100;
+	if (! rounds)
+		rounds = 1;
+
+	master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master_fd < 0 || grantpt(master_fd) || unlockpt(master_fd))
+	{
+		perror("pty");
+		return 1;
+	}
+
+	pthread_t writer;
+	pthread_create(&writer, NULL, wire_writer, NULL);
+
+	static const uint32_t bauds[] = {9600, 19200, 115200};
+	static const uint8_t bursts[] = {1, 16};
+
+	printf("%-8s %-6s %-8s %10s %10s %10s %8s\n", "baud", "burst", "loop",
+			"p50_us", "p99_us", "max_us", "wire%");
+	for (uint8_t b=0; b < sizeof(bauds) / sizeof(bauds[0]); b++)
+	{
+		EvoAll link;
+		link.callbacks.openclose_event = event_received;
+		link.begin(SerialSetup(ptsname(master_fd), bauds[b]));
+
+		for (uint8_t n=0; n < sizeof(bursts) / sizeof(bursts[0]); n++)
+		{
+			run(link, bauds[b], bursts[n], true, rounds);
+			run(link, bauds[b], bursts[n], false, rounds);
+		}
+
+		close(link.serialPort());
+	}
+
+	return 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * reactor_scaling.cpp -- Reactor benchmark for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Reactor scaling benchmark, for Linux.
+ *
+ * Opens N pseudo-terminal pairs, hands the slave sides to N EvoAll
+ * links and drives them either with the epoll Reactor or with the
+ * classic "call checkActivity() on every link" loop.  A feeder thread
+ * plays the EVO-All side: it sprinkles background door events over
+ * random links and, at a fixed rate, sends a brake event "probe" to a
+ * random link and measures how long it takes to reach the callback.
+ *
+ * Reported, per link count: CPU used by the driving thread (as a
+ * percentage of one core) and probe latency percentiles.
+ *
+ * Build, from the library root:
+ *
+ * 	g++ -O2 -std=gnu++11 -I. *.cpp extras/bench/reactor_scaling.cpp \
+ * 		-o reactor_scaling -lpthread
+ *
+ * Run:
+ * 	./reactor_scaling [seconds per run, default 3]
+ *
+ */
+
+#include "EvoLink.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+using namespace EvoLink;
+
+#define PROBES_PER_SECOND		200
+#define BACKGROUND_PER_SECOND	2000
+
+static std::atomic<bool> running;
+static std::atomic<uint64_t> probe_sent_ns;
+static std::atomic<bool> probe_outstanding;
+static std::vector<uint32_t> latencies_us;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void probe_received(Brake::Event event)
+{
+	if (! probe_outstanding.load())
+		return;
+
+	latencies_us.push_back((uint32_t)((now_ns() - probe_sent_ns.load()) / 1000));
+	probe_outstanding.store(false);
+}
+
+static void background_received(OpenClose::Event event)
+{
+	// nothing to do, just here so it goes through the callbacks
+}
+
+typedef struct FeederStruct {
+	std::vector<int> masters;
+} Feeder;
+
+static void * feeder_thread(void * arg)
+{
+	Feeder * feeder = (Feeder*)arg;
+	uint32_t seed = 1234;
+	uint64_t nextProbe = now_ns();
+	uint64_t nextBackground = now_ns();
+	const uint64_t probeInterval = 1000000000ULL / PROBES_PER_SECOND;
+	const uint64_t bgInterval = 1000000000ULL / BACKGROUND_PER_SECOND;
+
+	while (running.load())
+	{
+		uint64_t tNow = now_ns();
+		if (tNow >= nextBackground)
+		{
+			seed = (seed * 1103515245) + 12345;
+			uint8_t evt = (seed & 0x100) ? MSG_DOOR_OPENED : MSG_DOOR_CLOSED;
+			if (write(feeder->masters[(seed >> 16) % feeder->masters.size()], &evt, 1) < 0)
+				break;
+			nextBackground += bgInterval;
+		}
+
+		if (tNow >= nextProbe && ! probe_outstanding.load())
+		{
+			seed = (seed * 1103515245) + 12345;
+			uint8_t evt = MSG_BRAKE_ON;
+			probe_outstanding.store(true);
+			probe_sent_ns.store(now_ns());
+			if (write(feeder->masters[(seed >> 16) % feeder->masters.size()], &evt, 1) < 0)
+				break;
+			nextProbe += probeInterval;
+		}
+
+		struct timespec nap = {0, 50000};
+		nanosleep(&nap, NULL);
+	}
+
+	return NULL;
+}
+
+static double thread_cpu_seconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_THREAD, &ru);
+	return ru.ru_utime.tv_sec + (ru.ru_utime.tv_usec / 1e6)
+			+ ru.ru_stime.tv_sec + (ru.ru_stime.tv_usec / 1e6);
+}
+
+static void run(uint16_t numLinks, bool useReactor, double seconds)
+{
+	std::vector<int> masters;
+	EvoAll * links = new EvoAll[numLinks];
+
+	for (uint16_t i=0; i < numLinks; i++)
+	{
+		int m = posix_openpt(O_RDWR | O_NOCTTY);
+		if (m < 0 || grantpt(m) || unlockpt(m))
+		{
+			perror("pty");
+			exit(1);
+		}
+		masters.push_back(m);
+
+		links[i].callbacks.brake_event = probe_received;
+		links[i].callbacks.openclose_event = background_received;
+		links[i].begin(SerialSetup(ptsname(m)));
+	}
+
+	Reactor reactor(numLinks);
+	if (useReactor)
+	{
+		for (uint16_t i=0; i < numLinks; i++)
+			reactor.add(&links[i]);
+	}
+
+	latencies_us.clear();
+	latencies_us.reserve(PROBES_PER_SECOND * (seconds + 1));
+	probe_outstanding.store(false);
+	running.store(true);
+
+	Feeder feeder;
+	feeder.masters = masters;
+	pthread_t feederThread;
+	pthread_create(&feederThread, NULL, feeder_thread, &feeder);
+
+	double cpuStart = thread_cpu_seconds();
+	uint64_t start = now_ns();
+	uint64_t end = start + (uint64_t)(seconds * 1e9);
+
+	while (now_ns() < end)
+	{
+		if (useReactor)
+		{
+			reactor.runOnce(50);
+		} else {
+			for (uint16_t i=0; i < numLinks; i++)
+				links[i].checkActivity();
+		}
+	}
+
+	double cpuUsed = thread_cpu_seconds() - cpuStart;
+	double wall = (now_ns() - start) / 1e9;
+
+	running.store(false);
+	pthread_join(feederThread, NULL);
+
+	std::sort(latencies_us.begin(), latencies_us.end());
+	size_t n = latencies_us.size();
+	printf("%-8s %6u %8.1f %8zu %8u %8u %8u\n", useReactor ? "reactor" : "loop",
+			numLinks, 100.0 * cpuUsed / wall, n,
+			n ? latencies_us[n / 2] : 0,
+			n ? latencies_us[(n * 99) / 100] : 0,
+			n ? latencies_us[n - 1] : 0);
+	fflush(stdout);
+
+	for (uint16_t i=0; i < numLinks; i++)
+		close(masters[i]);
+	delete [] links;
+}
+
+int main(int argc, char * argv[])
+{
+	double seconds = (argc > 1) ? atof(argv[1]) : 3.0;
+
+	// 2 descriptors per link
+	struct rlimit rl;
+	getrlimit(RLIMIT_NOFILE, &rl);
+	rl.rlim_cur = rl.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rl);
+
+	const uint16_t counts[] = {1, 10, 100, 1000};
+
+	printf("%-8s %6s %8s %8s %8s %8s %8s\n", "mode", "links", "cpu%", "probes",
+			"p50us", "p99us", "maxus");
+	for (uint8_t i=0; i < sizeof(counts) / sizeof(counts[0]); i++)
+	{
+		run(counts[i], false, seconds);
+		run(counts[i], true, seconds);
+	}
+
+	return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * rx_ring.cpp -- RX ring test & benchmark for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * RX ring test & benchmark, for Linux.
+ *
+ * Exercises the RxRing used by the AVR interrupt-driven receive path
+ * (EVOLINK_RX_RING_ENABLE), with a thread standing in for the USART RX
+ * interrupt, at a few ring sizes:
+ *
+ *  - flood:  the producer pushes bytes as fast as it can, spinning
+ *            while the ring is full, and the consumer drains them: every
+ *            byte must come out, in order (checked by count and checksum);
+ *  - paced:  the producer pushes EVO-All events at the wire rate for
+ *            115200 baud, and the consumer feeds them to the parser
+ *            (parseMessages()), but stalls now and then, as a slow
+ *            loop() would; every event must reach its callback, or be
+ *            counted as an overrun.
+ *
+ * Output is one line per (test, ring size), whitespace separated; the
+ * exit status is non-zero if any check failed.
+ *
+ * Build, from the library root:
+ *
+ * 	g++ -O2 -std=gnu++11 -I. *.cpp extras/bench/rx_ring.cpp -o rx_ring -lpthread
+ *
+ * Run:
+ * 	./rx_ring [bytes per test, default 1000000]
+ *
+ */
+
+#include "EvoLink.h"
+#include "includes/serial/rx_ring.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace EvoLink;
+
+#define PACED_BAUD			115200
+#define STALL_EVERY_MS		20
+#define STALL_MS			5
+
+static uint32_t num_bytes = 1000000;
+static uint32_t num_events = 0;
+static volatile bool producer_done = false;
+
+static void event_received(OpenClose::Event event)
+{
+	num_events++;
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t t)
+{
+	struct timespec ts;
+	ts.tv_sec = t / 1000000000ULL;
+	ts.tv_nsec = t % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+template<uint8_t SIZE>
+struct Producer {
+	RxRing<SIZE> * ring;
+	bool paced;
+	uint32_t accepted;
+	uint32_t checksum;
+};
+
+static void add_to_checksum(uint32_t & sum, uint8_t b)
+{
+	sum = (sum * 31) + b;
+}
+
+template<uint8_t SIZE>
+static void * produce(void * arg)
+{
+	Producer<SIZE> * p = (Producer<SIZE> *)arg;
+	uint64_t charNs = (10ULL * 1000000000ULL) / PACED_BAUD;
+	uint64_t t = now_ns();
+	for (uint32_t i=0; i < num_bytes; i++)
+	{
+		uint8_t b;
+		if (p->paced)
+		{
+			t += charNs;
+			sleep_until_ns(t);
+			b = (i & 1) ? MSG_DOOR_CLOSED : MSG_DOOR_OPENED;
+		} else {
+			b = (uint8_t)(i * 7);
+			while (p->ring->full())
+				sched_yield(); // we may well be sharing a core with the consumer
+		}
+
+		if (p->ring->push(b))
+		{
+			p->accepted++;
+			add_to_checksum(p->checksum, b);
+		}
+	}
+
+	__atomic_store_n(&producer_done, true, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+template<uint8_t SIZE>
+static bool flood()
+{
+	RxRing<SIZE> ring;
+	Producer<SIZE> p = {&ring, false, 0, 0};
+	producer_done = false;
+
+	uint64_t start = now_ns();
+	pthread_t producer;
+	pthread_create(&producer, NULL, produce<SIZE>, &p);
+
+	uint8_t buf[SIZE];
+	uint32_t received = 0;
+	uint32_t checksum = 0;
+	for (;;)
+	{
+		bool done = __atomic_load_n(&producer_done, __ATOMIC_ACQUIRE);
+		size_t num = ring.readBytes(buf, sizeof(buf));
+		for (size_t i=0; i < num; i++)
+			add_to_checksum(checksum, buf[i]);
+		received += num;
+		if (done && ! num)
+			break;
+		if (! num)
+			sched_yield();
+	}
+	uint64_t spent = now_ns() - start;
+	pthread_join(producer, NULL);
+
+	bool ok = (received == num_bytes && received == p.accepted
+			&& checksum == p.checksum && ! ring.overruns());
+	printf("%-6s %-4u %10u %10u %10u %8.1f %s\n", "flood", SIZE, num_bytes, received,
+			ring.overruns(), (1000000.0 * num_bytes) / spent, ok ? "ok" : "FAIL");
+	return ok;
+}
+
+template<uint8_t SIZE>
+static bool paced(uint32_t numBytes)
+{
+	RxRing<SIZE> ring;
+	Producer<SIZE> p = {&ring, true, 0, 0};
+	producer_done = false;
+
+	EvoAll link;
+	link.callbacks.openclose_event = event_received;
+	num_events = 0;
+
+	uint32_t savedBytes = num_bytes;
+	num_bytes = numBytes;
+
+	uint64_t start = now_ns();
+	uint64_t nextStall = start + (STALL_EVERY_MS * 1000000ULL);
+	pthread_t producer;
+	pthread_create(&producer, NULL, produce<SIZE>, &p);
+
+	uint8_t buf[EVOLINK_RX_CHUNK_SIZE];
+	for (;;)
+	{
+		bool done = __atomic_load_n(&producer_done, __ATOMIC_ACQUIRE);
+		size_t num = ring.readBytes(buf, sizeof(buf));
+		link.parseMessages(buf, num);
+		if (done && ! num)
+			break;
+
+		if (now_ns() >= nextStall)
+		{
+			// loop() off doing something else
+			sleep_until_ns(now_ns() + (STALL_MS * 1000000ULL));
+			nextStall = now_ns() + (STALL_EVERY_MS * 1000000ULL);
+		}
+	}
+	uint64_t spent = now_ns() - start;
+	pthread_join(producer, NULL);
+
+	bool ok = (num_events == p.accepted && num_events + ring.overruns() == num_bytes);
+	printf("%-6s %-4u %10u %10u %10u %8.1f %s\n", "paced", SIZE, num_bytes, num_events,
+			ring.overruns(), (1000000.0 * num_bytes) / spent, ok ? "ok" : "FAIL");
+
+	num_bytes = savedBytes;
+	return ok;
+}
+
+int main(int argc, char * argv[])
+{
+	if (argc > 1)
+		num_bytes = atoi(argv[1]);
+	if (! num_bytes)
+		num_bytes = 1;
+
+	// the paced tests run at wire speed: keep them to a couple of seconds
+	uint32_t pacedBytes = (num_bytes < 20000) ? num_bytes : 20000;
+
+	bool ok = true;
+	printf("%-6s %-4s %10s %10s %10s %8s %s\n", "test", "size", "pushed", "received",
+			"overruns", "kbyte/s", "check");
+	ok = flood<16>() && ok;
+	ok = flood<64>() && ok;
+	ok = flood<128>() && ok;
+	ok = paced<16>(pacedBytes) && ok;
+	ok = paced<64>(pacedBytes) && ok;
+	ok = paced<128>(pacedBytes) && ok;
+
+	return ok ? 0 : 1;
+}
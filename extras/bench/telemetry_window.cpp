@@ -0,0 +1,166 @@
+/*
+ * telemetry_window.cpp -- Pipelined data request benchmark for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Telemetry refresh benchmark, for Linux.
+ *
+ * Runs the driver against the EVO-All Simulator, through a socketpair(),
+ * on a VirtualClock, and has it refresh all four data values over and
+ * over, with a ping thrown in: requestTach(), requestStatus(), ping(),
+ * requestVSS() and requestTemperature(), all at once.  The simulator
+ * answers the input status and ping at once and the others ~110 ms
+ * later, so the window mixes quick and slow answers.
+ *
+ * Each round checks that every request completed, that the input status
+ * came back as the simulator has it (its door flips every round), and
+ * that each ping's answer reached the callbacks as an event--i.e. that no
+ * answer was taken for another's.  Any mismatch exits with status 1.
+ *
+ * Reported: the time (on the virtual clock) for a round to complete.
+ *
+ * Build, from the library root:
+ *
+ * 	g++ -O2 -std=gnu++11 -I. *.cpp extras/bench/telemetry_window.cpp -o telemetry_window
+ *
+ * Run:
+ * 	./telemetry_window [rounds, default 1000]
+ *
+ */
+
+#include "EvoLink.h"
+#include "includes/sim/simulator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+using namespace EvoLink;
+
+#define ROUND_TIMEOUT_MS		2000
+
+static uint32_t pings_seen = 0;
+static uint32_t other_events = 0;
+
+static void message_received(DataLink::MessageCode msg)
+{
+	if (msg == MSG_PING)
+		pings_seen++;
+	else
+		other_events++;
+}
+
+static void openclose_event(OpenClose::Event) { /* the door we flip */ }
+
+static void fail(uint32_t round, const char * what)
+{
+	fprintf(stderr, "telemetry: round %u: %s\n", (unsigned)round, what);
+	exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+	uint32_t rounds = (argc > 1) ? atoi(argv[1]) : 1000;
+	if (! rounds)
+		rounds = 1000;
+
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+	{
+		perror("socketpair");
+		return 1;
+	}
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+	VirtualClock clock;
+	Simulator sim(42);
+	EvoAll link;
+	link.setClock(clock);
+	link.callbacks.message_received = message_received;
+	link.callbacks.openclose_event = openclose_event;
+	if (! link.begin(SerialSetup(fds[0], BAUDRATE_DEFAULT, false)))
+	{
+		fprintf(stderr, "telemetry: begin() failed\n");
+		return 1;
+	}
+
+	uint64_t totalMs = 0;
+	uint32_t worstMs = 0;
+	for (uint32_t r=0; r < rounds; r++)
+	{
+		sim.setInput(Input::Door, r & 1);
+
+		uint32_t start = clock.nowMs();
+		uint32_t pingsBefore = pings_seen;
+		RequestHandle tach = link.requestTach();
+		RequestHandle input = link.requestStatus();
+		bool pinged = link.ping();
+		RequestHandle vss = link.requestVSS();
+		RequestHandle temp = link.requestTemperature();
+		if (! (tach && input && pinged && vss && temp))
+			fail(r, "request refused");
+
+		while (link.statusOf(tach) == Request::Pending || link.statusOf(input) == Request::Pending
+				|| link.statusOf(vss) == Request::Pending || link.statusOf(temp) == Request::Pending
+				|| link.queuedRequests() || pings_seen == pingsBefore)
+		{
+			if ((clock.nowMs() - start) > ROUND_TIMEOUT_MS)
+				fail(r, "stuck");
+
+			// a byte takes ~1 ms on the wire, each way
+			link.serviceDeadlines();
+			clock.advanceMs(1);
+			sim.serviceFd(fds[1], clock.nowMs());
+			link.processIncoming();
+		}
+
+		if (link.statusOf(tach) != Request::Complete || link.statusOf(input) != Request::Complete
+				|| link.statusOf(vss) != Request::Complete || link.statusOf(temp) != Request::Complete)
+			fail(r, "request not completed");
+
+		if (link.valueOf(input) != sim.inputs().asByte())
+			fail(r, "input status mismatched");
+
+		if (pings_seen != pingsBefore + 1 || other_events)
+			fail(r, "ping answer mismatched");
+
+		uint32_t spent = clock.nowMs() - start;
+		totalMs += spent;
+		if (spent > worstMs)
+			worstMs = spent;
+	}
+
+	printf("{\"bench\":\"telemetry\",\"case\":\"mixed_window\",\"rounds\":%u,\"avg_ms\":%.1f,\"max_ms\":%u}\n",
+			(unsigned)rounds, (double)totalMs / rounds, (unsigned)worstMs);
+
+	link.end();
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * session_capture.h -- Session capture/replay for EvoLink, part of the
+ * cross-platform EVO-All interface library.
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Session capture and replay, for POSIX systems.
+ *
+ * A SessionRecorder, attached to a link with EvoAll::setRecorder(), logs
+ * every byte sent to or received from the EVO-All to a compact capture
+ * file.  A SessionReplay then feeds a capture back into an EvoAll: received
+ * bytes go to parseMessage(), transmitted ones to noteTransmitted() so
+ * responses are matched to their requests as they were live.  Replay may
+ * run at the recorded speed, or as fast as possible under a virtual
+ * clock, which steps through the recorded timestamps (so request timeouts
+ * and the like behave as they did) without waiting for them.
+ *
+ * 	SessionRecorder rec;
+ * 	rec.open("garage.evocap", 9600);
+ * 	EVO.setRecorder(&rec); // records on EVO's clock from here on
+ * 	...
+ *
+ * 	EvoAll link; // not begun: nothing goes out on a replay
+ * 	link.callbacks.openclose_event = doorEvent;
+ * 	SessionReplay replay;
+ * 	if (replay.open("garage.evocap"))
+ * 		replay.run(link, SessionReplay::VirtualTime);
+ *
+ * File format (little-endian):
+ *
+ *  header, 16 bytes:
+ * 	"EVCP"		magic
+ * 	uint8		version (1)
+ * 	uint8		bits per character on the wire (e.g. 10 for 8N1)
+ * 	uint16		reserved
+ * 	uint32		baud rate
+ * 	uint32		capture start (UNIX time, seconds)
+ *
+ *  followed by one record per byte:
+ * 	uint8		bit 7: set if transmitted (by us), clear if received
+ * 				bits 0-6: ms since the previous record (0-126), or
+ * 				127: the delay follows, as a uint32
+ * 	[uint32]	ms since the previous record, if escaped
+ * 	uint8		the byte
+ *
+ */
+
+#ifndef EVOLINK_SESSION_CAPTURE_H_
+#define EVOLINK_SESSION_CAPTURE_H_
+
+#include "../driver.h"
+
+#ifdef PLATFORM_POSIX
+
+#include <stdio.h>
+
+#define EVOLINK_CAPTURE_VERSION			1
+#define EVOLINK_CAPTURE_HEADER_SIZE		16
+
+namespace EvoLink {
+
+typedef struct CaptureRecordStruct {
+	uint32_t time_ms;	// since the start of the capture
+	uint8_t data;
+	bool transmitted;	// sent by us, rather than received
+} CaptureRecord;
+
+class SessionRecorder {
+public:
+	SessionRecorder();
+	~SessionRecorder();
+
+	bool open(const char * path, uint32_t baud, uint8_t bitsPerChar=10);
+	void close();
+	bool isOpen() { return file != NULL; }
+
+	void record(bool transmitted, uint8_t byte);
+	void record(bool transmitted, const uint8_t * bytes, size_t len);
+
+	uint32_t numRecords() { return num_records; }
+
+	// where record times come from: SystemClock unless told otherwise.
+	// EvoAll::setRecorder() hands us the link's.
+	void setClock(Clock & c) { clock_src = &c; last_time = c.nowMs(); }
+
+private:
+	Clock * clock_src;
+	FILE * file;
+	uint32_t last_time;
+	uint32_t num_records;
+};
+
+class SessionReplay {
+public:
+	typedef enum ReplayPaceEnum {
+		RecordedSpeed = 0,	// real time, as captured
+		VirtualTime			// as fast as possible, on a VirtualClock following the capture
+	} Pace;
+
+	SessionReplay();
+	~SessionReplay();
+
+	bool open(const char * path);
+	void close();
+
+	// from the header
+	uint32_t baudRate() { return baud_rate; }
+	uint8_t bitsPerCharacter() { return bits_per_char; }
+	uint32_t startTime() { return start_time; }
+
+	// read the next record, false at the end (or on a truncated file)
+	bool next(CaptureRecord & rec);
+
+	// feed the (rest of the) capture to link, returns the number of
+	// records replayed.  For VirtualTime, the link is switched to a
+	// VirtualClock for the duration, then back to its own clock.
+	uint32_t run(EvoAll & link, Pace pace=VirtualTime);
+
+private:
+	FILE * file;
+	uint32_t baud_rate;
+	uint8_t bits_per_char;
+	uint32_t start_time;
+	uint32_t elapsed;
+	VirtualClock virtual_clock;
+};
+
+} /* namespace EvoLink */
+
+#endif /* PLATFORM_POSIX */
+
+#endif /* EVOLINK_SESSION_CAPTURE_H_ */
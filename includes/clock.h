@@ -0,0 +1,125 @@
+/*
+ * clock.h -- Injectable time source for EvoLink, part of the
+ * cross-platform EVO-All interface library.
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Clocks -- where EvoAll gets its time from.
+ *
+ * Everything timing-related in the driver (pacing, wake-up tracking,
+ * response timeouts, synchronous getters, checkActivity() waits...) goes
+ * through the link's Clock.  By default that's SystemClock, which uses the
+ * platform's timeMs()/delayMs()/delayUs() (i.e. millis() and friends).
+ *
+ * Swap in a VirtualClock and time only moves when you (or the driver's
+ * own delays and waits) move it, instantly:
+ *
+ * 	VirtualClock clock(0xffffff00); // a few ms before wrapping around
+ * 	EvoAll link;
+ * 	link.setClock(clock);
+ * 	...
+ * 	link.checkActivity(500); // returns right away, 500 virtual ms later
+ * 	clock.advanceMs(60000);  // a minute, in no time
+ *
+ * so hour-long scenarios run in milliseconds, and the uint32 ms wrap
+ * around can be reached on purpose.  A Clock only needs to be set before
+ * the link is used, and must outlive it.
+ *
+ */
+
+#ifndef EVOLINK_CLOCK_H_
+#define EVOLINK_CLOCK_H_
+
+#include "platform.h"
+#include "serial.h"
+
+namespace EvoLink {
+
+class Clock {
+public:
+	virtual ~Clock() {}
+
+	virtual uint32_t nowMs() = 0;
+	virtual void delayMs(uint16_t ms) = 0;
+	virtual void delayUs(uint16_t us) = 0;
+
+	// wait (up to timeoutUs) for incoming data on serial, returning
+	// as soon as there's something to read.  Returns true if there is.
+	virtual bool waitForData(SerialConnection & serial, uint32_t timeoutUs) = 0;
+};
+
+// the real thing: the platform's timeMs()/delayMs()/delayUs()
+class RealClock : public Clock {
+public:
+	constexpr RealClock() {}
+
+	uint32_t nowMs() { return timeMs(); }
+	void delayMs(uint16_t ms) { ::delayMs(ms); }
+	void delayUs(uint16_t us) { ::delayUs(us); }
+	bool waitForData(SerialConnection & serial, uint32_t timeoutUs)
+	{
+		return serial.waitForData(timeoutUs);
+	}
+};
+
+// simulated time: delays and waits just advance it, immediately
+class VirtualClock : public Clock {
+public:
+	VirtualClock(uint32_t startMs=0) : now_ms(startMs), now_us(0) {}
+
+	uint32_t nowMs() { return now_ms; }
+	void delayMs(uint16_t ms) { advanceMs(ms); }
+	void delayUs(uint16_t us) { advanceUs(us); }
+	bool waitForData(SerialConnection & serial, uint32_t timeoutUs)
+	{
+		// whatever's there is all there'll be
+		if (serial.available())
+			return true;
+
+		advanceUs(timeoutUs);
+		return serial.available() > 0;
+	}
+
+	void set(uint32_t ms) { now_ms = ms; now_us = 0; }
+	void advanceMs(uint32_t ms) { now_ms += ms; }
+	void advanceUs(uint32_t us)
+	{
+		us += now_us;
+		now_ms += us / 1000UL;
+		now_us = us % 1000UL;
+	}
+
+private:
+	uint32_t now_ms;
+	uint16_t now_us; // sub-ms remainder
+};
+
+// the default for every EvoAll
+extern RealClock SystemClock;
+
+} /* namespace EvoLink */
+
+#endif /* EVOLINK_CLOCK_H_ */
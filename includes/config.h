@@ -39,8 +39,19 @@
 
 // PLATFORM_XXX
 // Define *one of* the available platforms, for which you
-// are compiling.  Currently, only PLATFORM_ARDUINO supported.
+// are compiling.  Currently supported are PLATFORM_ARDUINO
+// and PLATFORM_POSIX (Linux & co, talking to a tty device).
+// If you don't define either, we'll guess based on the toolchain.
+// #define PLATFORM_ARDUINO
+// #define PLATFORM_POSIX
+
+#if !(defined(PLATFORM_ARDUINO) || defined(PLATFORM_POSIX))
+#if defined(ARDUINO) || !defined(__unix__)
 #define PLATFORM_ARDUINO
+#else
+#define PLATFORM_POSIX
+#endif
+#endif
 
 
 // Default baudrate specified by BAUDRATE_DEFAULT
@@ -53,6 +64,11 @@
 // commands/requests on the serial line.
 #define AUTODELAY_DEFAULT_MS							50
 
+// EVOLINK_COMMAND_QUEUE_SIZE -- number of commands/requests that may
+// be waiting for their turn on the line (see EvoAll::makeRequest()),
+// each costing 9 bytes of RAM on AVR.
+#define EVOLINK_COMMAND_QUEUE_SIZE						8
+
 // POSTWAKEUP_AUTO_DELAY_MS extra delay to insert after
 // sending a wakeup command, to ensure the EVO-All is
 // up and running.
@@ -63,16 +79,99 @@
 // ready to go.
 #define POSTGROUNDOUT_ON_DELAY_MS						100
 
+// EVOLINK_AWAKE_WINDOW_MS -- the EVO-All dozes off if it hasn't heard
+// from us in a while.  The driver considers it awake for this many ms
+// after anything is sent (a little less than the device's own window, to
+// be safe), and:
+//  - with auto wake-up on (see EvoAll::setAutoWakeUp()), sends a WakeUp
+//    ahead of any command that would go out after the window has lapsed;
+//  - skips wakeUp() calls, and the POSTWAKEUP_AUTO_DELAY_MS, while it's
+//    still awake;
+//  - with a keep-alive set (EvoAll::setKeepAliveMs()), keeps it awake for
+//    that long after the last command, so the next one needn't wait.
+#define EVOLINK_AWAKE_WINDOW_MS							250
+#define AUTO_WAKEUP_DEFAULT								true
+#define KEEPALIVE_DEFAULT_MS							0
+
 // if you define MINTIME_BETWEEN_WAKEUPS_MS, wakeUp will not
 // be repeated within MINTIME_BETWEEN_WAKEUPS_MS ms.  So if you
 // call
 //  EVO.wakeUp(); // wake-up command issued
 //	EVO.XYZ();
 //  EVO.wakeUp(); // to soon, wake-up command ignored.
-#define MINTIME_BETWEEN_WAKEUPS_MS						1100
+// Superseded by the awake window tracking, above: if longer than
+// EVOLINK_AWAKE_WINDOW_MS, this would skip wake-ups that are needed.
+// #define MINTIME_BETWEEN_WAKEUPS_MS						1100
+
+
+// ABS_REQUEST_RESPONSE_TIMEOUT_MS -- if the response to a data
+// request hasn't arrived after this long, give up on it (and
+// report an ErrorMessage::RequestTimeout).
+#define ABS_REQUEST_RESPONSE_TIMEOUT_MS				500
+
+// SYNCHRONOUS_GETTER_DEFAULT_TIMEOUT_MS -- how long getTach() & co.
+// wait for the response, by default (they return as soon as it arrives).
+#define SYNCHRONOUS_GETTER_DEFAULT_TIMEOUT_MS			ABS_REQUEST_RESPONSE_TIMEOUT_MS
+
+// EVOLINK_REQUEST_POOL_SIZE -- number of data request handles
+// (see EvoAll::requestTach() & co.) available, 15 bytes of RAM each on AVR.
+#define EVOLINK_REQUEST_POOL_SIZE						4
+
+// EVOLINK_MAX_INFLIGHT_REQUESTS -- number of data requests that may
+// be sent before their responses come back.  Responses are matched to
+// requests oldest first, so requests the EVO-All answers at once
+// (Request_Input, ping, pong) wait for any tach, VSS or temperature
+// request in flight, whose answers take longer.  Set to 1 to go back to
+// strictly one-at-a-time requests.
+#define EVOLINK_MAX_INFLIGHT_REQUESTS					4
+
+#if EVOLINK_MAX_INFLIGHT_REQUESTS > EVOLINK_REQUEST_POOL_SIZE
+#error "EVOLINK_MAX_INFLIGHT_REQUESTS can't exceed EVOLINK_REQUEST_POOL_SIZE"
+#endif
+
+// EVOLINK_INPUT_STATUS_MAX_AGE_MS -- the driver keeps track of door,
+// hood, trunk, tach and brake states from the events it receives (and
+// Request_Input responses).  getStatus() answers from this cache, without
+// going to the EVO-All, when every field was updated within this many ms.
+// Set to 0 to trust the cache indefinitely, once every field is known.
+#define EVOLINK_INPUT_STATUS_MAX_AGE_MS					30000
+
+// Define EVOLINK_COMMAND_SUPPRESSION_ENABLE to have the driver track the
+// commanded state of each on/off output, so commands repeating it may be
+// skipped (see EvoAll::setCommandSuppression()).  Costs 64 bytes of RAM
+// per link on AVR, and compiles out entirely when not defined.
+// COMMAND_SUPPRESSION_DEFAULT_POLICY -- whether such commands are skipped
+// to begin with.  The EVO-All may change some outputs on its own (e.g.
+// remote start), so this is opt-in.
+// COMMAND_STATE_REFRESH_DEFAULT_MS -- when suppressing, the command is
+// still re-sent if it's been this long since it last went out (0: never).
+// #define EVOLINK_COMMAND_SUPPRESSION_ENABLE
+#define COMMAND_SUPPRESSION_DEFAULT_POLICY				Suppression::Disabled
+#define COMMAND_STATE_REFRESH_DEFAULT_MS				10000
+
+// EVOLINK_MAX_CUSTOM_HANDLERS -- number of messages whose handler may be
+// overridden at once (see EvoAll::setHandlerForMessage()), per link.
+// Each costs 6 bytes of RAM on AVR.
+#ifndef EVOLINK_MAX_CUSTOM_HANDLERS
+#define EVOLINK_MAX_CUSTOM_HANDLERS						4
+#endif
+
+// EVOLINK_IDLE_GAP_PERCENT -- once the receive buffer is empty,
+// checkActivity() waits this long, as a percentage of a character
+// time (derived from the baud rate and frame format), for the next
+// byte before deciding the line is idle.  150 is the usual "t1.5".
+#define EVOLINK_IDLE_GAP_PERCENT						150
 
+// EVOLINK_RX_CHUNK_SIZE -- max number of bytes pulled from the
+// serial port in one go (lives on the stack, in checkActivity()).
+#define EVOLINK_RX_CHUNK_SIZE							16
 
-#define SYNCHRONOUS_GETTER_DEFAULT_TIMEOUT_MS			ABS_REQUEST_RESPONSE_TIME_MINIMUM_MS * 3
+// Define EVOLINK_STATISTICS_ENABLE to have the driver keep link
+// statistics (see EvoAll::statistics() and LinkStatistics, in types.h):
+// byte/command/event counts, errors, pacing and request latency
+// histograms.  Costs about 150 bytes of RAM, and compiles out entirely
+// when not defined.
+// #define EVOLINK_STATISTICS_ENABLE
 
 // define AUTO_CHECKACTIVITY_BEFORE_REQUESTS to
 // automatically do a checkActivity() before any
@@ -80,8 +179,92 @@
 #define AUTO_CHECKACTIVITY_BEFORE_REQUESTS
 
 
+// Define EVOLINK_TRACE_ENABLE to have the driver log every byte sent
+// and received (and what it did with it) to a ring of
+// EVOLINK_TRACE_SIZE compact records in RAM (4 bytes each), which you
+// can drainTrace() (or dumpTrace(), see below) when things are quiet.
+// Recording is just a few stores, so it may be left on in production.
+// EVOLINK_TRACE_SIZE must be a power of 2, 256 at most.
+// #define EVOLINK_TRACE_ENABLE
+#define EVOLINK_TRACE_SIZE								64
+
+// Define EVOLINK_EVENT_BUS_ENABLE to let several subscribers each get
+// whichever messages they pick (see EvoAll::subscribe()), on top of the
+// usual callbacks.  EVOLINK_MAX_SUBSCRIBERS (8 at most) sets the size of
+// the subscriber table, each entry costing 5 bytes of RAM on AVR, plus
+// 30 bytes for the table as a whole.
+// #define EVOLINK_EVENT_BUS_ENABLE
+#ifndef EVOLINK_MAX_SUBSCRIBERS
+#define EVOLINK_MAX_SUBSCRIBERS							4
+#endif
+
+// Define EVOLINK_EVENT_QUEUE_ENABLE to have events (and errors) that
+// checkActivity() receives queued, in a ring of EVOLINK_EVENT_QUEUE_SIZE
+// entries (10 bytes each on AVR), rather than handed to your callbacks on
+// the spot: you then deliver them with EvoAll::dispatchPending(), so slow
+// callbacks no longer hold up draining the serial port.  The same goes
+// for data request completion handlers and requested_data_received.
+// EVOLINK_EVENT_QUEUE_SIZE must be a power of 2, 256 at most.
+// #define EVOLINK_EVENT_QUEUE_ENABLE
+#define EVOLINK_EVENT_QUEUE_SIZE						16
+
+// Define EVOLINK_RX_RING_ENABLE (AVR only) to have EvoLink drive the
+// EVO-All's USART itself, rather than through HardwareSerial: its RX
+// interrupt then stores incoming bytes in a ring of EVOLINK_RX_RING_SIZE
+// bytes owned by EvoLink, for the driver to pick up, and counts any that
+// arrive while it's full (see includes/serial/rx_ring.h).  Set
+// EVOLINK_RX_RING_USART to the USART's number (0 on an Uno, 0-3 on a
+// Mega; picking one the part doesn't have is an error) and leave the
+// matching SerialN alone, as its interrupt handlers would clash with
+// ours.  EVOLINK_RX_RING_SIZE must be a power of 2, 128 at most.
+// #define EVOLINK_RX_RING_ENABLE
+#ifndef EVOLINK_RX_RING_USART
+#define EVOLINK_RX_RING_USART							1
+#endif
+#ifndef EVOLINK_RX_RING_SIZE
+#define EVOLINK_RX_RING_SIZE							64
+#endif
+
 // Define DEBUG_USART_ENABLE (and set SerialSetup param
-// accordingly) to enable debug output on usart/serial).
+// accordingly) to enable debug output on usart/serial): this
+// turns on the trace, above, and EvoAll::dumpTrace() to print it.
+// Only available on PLATFORM_ARDUINO.
 // #define DEBUG_USART_ENABLE
 
+#if defined(DEBUG_USART_ENABLE) && !defined(PLATFORM_ARDUINO)
+#undef DEBUG_USART_ENABLE
+#endif
+
+#if defined(EVOLINK_RX_RING_ENABLE) && !(defined(PLATFORM_ARDUINO) && defined(__AVR__))
+#undef EVOLINK_RX_RING_ENABLE
+#endif
+
+#if defined(DEBUG_USART_ENABLE) && !defined(EVOLINK_TRACE_ENABLE)
+#define EVOLINK_TRACE_ENABLE
+#endif
+
+#if defined(EVOLINK_TRACE_ENABLE) && \
+	((EVOLINK_TRACE_SIZE & (EVOLINK_TRACE_SIZE - 1)) || EVOLINK_TRACE_SIZE > 256)
+#error "EVOLINK_TRACE_SIZE must be a power of 2, 256 at most"
+#endif
+
+#if EVOLINK_MAX_CUSTOM_HANDLERS < 1 || EVOLINK_MAX_CUSTOM_HANDLERS > 30
+#error "EVOLINK_MAX_CUSTOM_HANDLERS must be between 1 and 30"
+#endif
+
+#if defined(EVOLINK_EVENT_BUS_ENABLE) && \
+	(EVOLINK_MAX_SUBSCRIBERS < 1 || EVOLINK_MAX_SUBSCRIBERS > 8)
+#error "EVOLINK_MAX_SUBSCRIBERS must be between 1 and 8"
+#endif
+
+#if defined(EVOLINK_EVENT_QUEUE_ENABLE) && \
+	((EVOLINK_EVENT_QUEUE_SIZE & (EVOLINK_EVENT_QUEUE_SIZE - 1)) || EVOLINK_EVENT_QUEUE_SIZE > 256)
+#error "EVOLINK_EVENT_QUEUE_SIZE must be a power of 2, 256 at most"
+#endif
+
+#if defined(EVOLINK_RX_RING_ENABLE) && \
+	((EVOLINK_RX_RING_SIZE & (EVOLINK_RX_RING_SIZE - 1)) || EVOLINK_RX_RING_SIZE > 128)
+#error "EVOLINK_RX_RING_SIZE must be a power of 2, 128 at most"
+#endif
+
 #endif /* EVOLINK_CONFIG_H_ */
@@ -291,11 +291,49 @@ namespace ErrorMessage {
 typedef enum DLErrorEvent {
 	UnsupportedValue = 0,
 	RequestTimeout,
+	CommandExpired, // queued command dropped, param is the RequestCode
+	RxOverrun,		// incoming bytes were lost, param is the number of overruns (255 max)
 	Temperature_Error = MSG_TEMPERATURE_ERROR
 
 } Event ;
 }
 
+// the cheap conversions mentioned above, checked at compile time.
+#define EVOLINK_ASSERT_SAME_CODE(evt, msg) \
+	static_assert((int)(evt) == (int)DataLink::msg, #evt " must match DataLink::" #msg)
+
+EVOLINK_ASSERT_SAME_CODE(RemoteStarter::Disarm, RemoteStarter_Disarm);
+EVOLINK_ASSERT_SAME_CODE(RemoteStarter::Arm, RemoteStarter_Arm);
+EVOLINK_ASSERT_SAME_CODE(RemoteStarter::On, RemoteStarter_On);
+EVOLINK_ASSERT_SAME_CODE(RemoteStarter::Off, RemoteStarter_Off);
+EVOLINK_ASSERT_SAME_CODE(RemoteStarter::UnlockDisarm, RemoteStarter_UnlockDisarm);
+EVOLINK_ASSERT_SAME_CODE(RemoteStarter::LockArm, RemoteStarter_LockArm);
+
+EVOLINK_ASSERT_SAME_CODE(OpenClose::Door_Opened, Door_Opened);
+EVOLINK_ASSERT_SAME_CODE(OpenClose::Door_Closed, Door_Closed);
+EVOLINK_ASSERT_SAME_CODE(OpenClose::Hood_Opened, Hood_Opened);
+EVOLINK_ASSERT_SAME_CODE(OpenClose::Hood_Closed, Hood_Closed);
+EVOLINK_ASSERT_SAME_CODE(OpenClose::Trunk_Opened, Trunk_Opened);
+EVOLINK_ASSERT_SAME_CODE(OpenClose::Trunk_Closed, Trunk_Closed);
+
+EVOLINK_ASSERT_SAME_CODE(Brake::HandBrake_On, HandBrake_On);
+EVOLINK_ASSERT_SAME_CODE(Brake::HandBrake_Off, HandBrake_Off);
+EVOLINK_ASSERT_SAME_CODE(Brake::On, Brake_On);
+EVOLINK_ASSERT_SAME_CODE(Brake::Off, Brake_Off);
+
+EVOLINK_ASSERT_SAME_CODE(Sensor::Shock, ShockSensor_Trigger);
+EVOLINK_ASSERT_SAME_CODE(Sensor::Alarm_PreWarn, AlarmSensor_PreWarn);
+EVOLINK_ASSERT_SAME_CODE(Sensor::Tilt, TiltSensor_Trigger);
+EVOLINK_ASSERT_SAME_CODE(Sensor::Over_15MPH, VSS_Over_15MPH);
+
+EVOLINK_ASSERT_SAME_CODE(Tach::On, Tach_On);
+EVOLINK_ASSERT_SAME_CODE(Tach::Off, Tach_Off);
+EVOLINK_ASSERT_SAME_CODE(Tach::OverRev, Tach_OverRev);
+
+EVOLINK_ASSERT_SAME_CODE(ErrorMessage::Temperature_Error, Temperature_Error);
+
+#undef EVOLINK_ASSERT_SAME_CODE
+
 } /* namespace EvoLink */
 
 
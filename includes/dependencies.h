@@ -37,5 +37,9 @@
 #include "dependencies/arduino_deps.h"
 #endif
 
+#ifdef PLATFORM_POSIX
+#include "dependencies/posix_deps.h"
+#endif
+
 
 #endif /* EVOLINK_DEPENDENCIES_H_ */
@@ -33,5 +33,11 @@
 #include "avr_deps.h"
 #include <Arduino.h>
 
+// constant tables are kept in flash, where supported
+#define EVOLINK_PROGMEM					PROGMEM
+#define EVOLINK_PGM_READ_BYTE(addr)		pgm_read_byte(addr)
+#define EVOLINK_PGM_READ_BLOCK(dest, src, len)	memcpy_P((dest), (src), (len))
+
+
 
 #endif /* EVOLINK_ARDUINO_DEPS_H_ */
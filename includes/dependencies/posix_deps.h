@@ -0,0 +1,60 @@
+/*
+ * posix_deps.h -- POSIX dependencies for EvoLink, part of the
+ * cross-platform EVO-All interface library.
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * This file contains the external dependencies used when building
+ * for PLATFORM_POSIX (Linux and friends, with the EVO-All on a tty).
+ *
+ */
+
+#ifndef EVOLINK_POSIX_DEPS_H_
+#define EVOLINK_POSIX_DEPS_H_
+
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+
+// no separate program memory here, tables are just const data
+#define EVOLINK_PROGMEM
+#define EVOLINK_PGM_READ_BYTE(addr)		(*(const uint8_t *)(addr))
+#define EVOLINK_PGM_READ_BLOCK(dest, src, len)	memcpy((dest), (src), (len))
+
+
+
+#endif /* EVOLINK_POSIX_DEPS_H_ */
@@ -36,6 +36,14 @@
  * You don't need to instantiate it, but you must call begin()
  * with a SerialSetup parameter before using it.
  *
+ * If you've got more than one EVO-All to talk to (say, on a gateway),
+ * just create as many EvoAll objects as required--each owns its
+ * serial connection, message handlers and pending request state.
+ * With the default config.h, sizeof(EvoAll) is 308 bytes on AVR, mostly
+ * the command queue (9 bytes per EVOLINK_COMMAND_QUEUE_SIZE entry), the
+ * request pool (15 per EVOLINK_REQUEST_POOL_SIZE) and the callbacks; the
+ * optional features add their own (see config.h).
+ *
  * In general, you:
  *
  *  - may assign callbacks for various types of EVO-All events,
@@ -55,8 +63,13 @@
 #include "serial.h"
 #include "types.h"
 #include "platform.h"
+#include "clock.h"
+
 
 
+// number of DataLink::MessageCodes the driver knows how to dispatch
+#define EVOLINK_NUM_SUPPORTED_MESSAGES		30
+#define EVOLINK_NUM_OUTPUT_PAIRS			11
 
 namespace EvoLink {
 
@@ -70,9 +83,12 @@ public:
 	CallbackContainer callbacks;
 
 	/*
-	 * setup/startup
+	 * setup/startup -- begin() returns false if the serial port
+	 * couldn't be set up (see SerialConnection::setup()).
 	 */
-	void begin(SerialSetup serial);
+	bool begin(SerialSetup serial);
+	// let go of the serial port (closing it, if begin() opened it)
+	void end() { serial.end(); }
 	uint8_t autoDelayMs() { return auto_delay_ms;}
 	void setAutoDelayMs(uint8_t ms) { auto_delay_ms = ms;}
 
@@ -83,19 +99,101 @@ public:
 	// that function will be called when the message arrives,
 	// rather than being dispatched to the callback as defined
 	// above.
-	GenericMessageHandler handlerForMessage(DataLink::MessageCode code);
-	GenericMessageHandler handlerForMessage(uint8_t raw_msg_code);
+	// As with the callbacks, the handler may instead be one that's also
+	// passed the link and a context (see Callback in types.h).
+	// handlerForMessage() evaluates to false when no override is set (i.e.
+	// the message goes to the callbacks), and setting a NULL handler
+	// restores the standard dispatch.  Use supportsMessage() to check
+	// whether a code is known at all.
+	// Up to EVOLINK_MAX_CUSTOM_HANDLERS messages may be overridden at
+	// once: setHandlerForMessage() returns false for any more.
+	GenericMessageCallback handlerForMessage(DataLink::MessageCode code);
+	GenericMessageCallback handlerForMessage(uint8_t raw_msg_code);
 	bool setHandlerForMessage(DataLink::MessageCode code, GenericMessageHandler useCallback);
+	bool setHandlerForMessage(DataLink::MessageCode code,
+			GenericMessageCallback::ContextFunction useCallback, void * context);
+	bool supportsMessage(uint8_t raw_msg_code);
+
+#ifdef EVOLINK_EVENT_BUS_ENABLE
+	// Event bus: on top of the callbacks (or custom handler) above, up to
+	// EVOLINK_MAX_SUBSCRIBERS subscribers may each get whichever messages
+	// their MessageMask selects, e.g. for a logger and alarm logic that
+	// both want the door events:
+	//
+	//	EvoLink::MessageMask doors;
+	//	doors.add(EvoLink::DataLink::Door_Opened).add(EvoLink::DataLink::Door_Closed);
+	//	int8_t id = EVO.subscribe(doors, logDoor);
+	//
+	// Subscribers are called after the callbacks, in id order.  Handlers
+	// may be plain, or be passed the link and a context (as the
+	// callbacks, see Callback in types.h).  subscribe() returns the
+	// subscriber id, or -1 if the table is full.
+	int8_t subscribe(const MessageMask & mask, GenericMessageHandler handler);
+	int8_t subscribe(const MessageMask & mask,
+			GenericMessageCallback::ContextFunction handler, void * context);
+	bool resubscribe(int8_t id, const MessageMask & mask);
+	bool unsubscribe(int8_t id);
+#endif
 
 
 	/*
 	 * check serial conn for incoming messages and
-	 * dispatch as appropriate
+	 * dispatch as appropriate.  Returns as soon as the line
+	 * goes idle (see EVOLINK_IDLE_GAP_PERCENT) or, if a timeout
+	 * is given, once something's been received or timeout ms
+	 * have passed.
 	 */
 	void checkActivity(uint16_t timeout=0);
 
 	void delayWhileCheckingActivity(uint16_t delayMs, uint16_t activityCheckPeriod=250);
 
+	/*
+	 * Event-loop friendly alternatives to checkActivity(), which never
+	 * delay:
+	 *  - processIncoming() parses whatever bytes are waiting, returns count;
+	 *  - nextDeadline() tells you when serviceDeadlines() next needs
+	 *    to be called (returns false if nothing is scheduled);
+	 *  - serviceDeadlines() handles anything that's come due (e.g.
+	 *    request response timeouts).
+	 * The POSIX Reactor uses these to drive many links at once.
+	 */
+	uint16_t processIncoming();
+	bool nextDeadline(uint32_t & deadline);
+	void serviceDeadlines();
+
+	SerialPort serialPort() { return serial.handle(); }
+
+	/*
+	 * Where this link gets its time from (see clock.h): SystemClock
+	 * unless told otherwise, e.g. a VirtualClock for testing.
+	 */
+	void setClock(Clock & c) { clock_src = &c; }
+	Clock & clock() { return *clock_src; }
+
+#ifdef PLATFORM_POSIX
+	// capture all traffic on this link (see capture/session_capture.h),
+	// timestamped by this link's clock: set that first.
+	void setRecorder(SessionRecorder * rec);
+#endif
+
+	/*
+	 * Feed received bytes to the parser directly--normally done for you
+	 * by checkActivity()/processIncoming() but useful if you're getting
+	 * the bytes by some other means.  parseMessage() returns true if the
+	 * byte was handled (dispatched or taken as a response),
+	 * parseMessages() the number of such bytes.
+	 */
+	bool parseMessage(int msg);
+	uint16_t parseMessages(const uint8_t * bytes, size_t len);
+
+	/*
+	 * The other half of feeding the parser yourself, e.g. when replaying
+	 * a capture: account for reqCode having gone out (pacing, and the
+	 * in-flight window for data requests, whose responses then go to
+	 * callbacks.requested_data_received), without actually sending it.
+	 */
+	void noteTransmitted(DataLink::RequestCode reqCode);
+
 
 	/*
 	 * Making requests.
@@ -104,12 +202,92 @@ public:
 	 * or use any of the helper methods below--mostly inlined such that
 	 * there is no overhead anyway, it will just make your code
 	 * clearer.
+	 *
+	 * Requests never block: if the line is free (autoDelayMs() and any
+	 * post wake-up/ground-out delays have elapsed) the request goes out
+	 * immediately, otherwise it's queued and sent from checkActivity()
+	 * (or serviceDeadlines()) when its turn comes.  Safety-related
+	 * commands jump ahead of other queued requests (see Priority::Level).
+	 *
+	 * If expiresInMs is non-zero and the request couldn't be sent within
+	 * that many ms, it's dropped (with an ErrorMessage::CommandExpired)
+	 * rather than sent late.
+	 *
+	 * With command suppression enabled (see below), on/off commands that
+	 * repeat the last commanded state of their output are skipped (and
+	 * return true), unless forced through forceRequest().
+	 *
+	 * Returns false if the queue is full, or if this is a data request
+	 * and no request handle is available.
 	 */
-	bool makeRequest(DataLink::RequestCode reqCode);
+	bool makeRequest(DataLink::RequestCode reqCode, uint16_t expiresInMs=0);
+	bool forceRequest(DataLink::RequestCode reqCode, uint16_t expiresInMs=0);
+	bool queueRequest(DataLink::RequestCode reqCode, Priority::Level priority,
+			uint16_t expiresInMs=0, bool force=false);
+
+#ifdef EVOLINK_COMMAND_SUPPRESSION_ENABLE
+	/*
+	 * Command suppression, for on/off output pairs (parking lights, alarm,
+	 * accessory, starter kill...).  With Suppression::Enabled, a command that
+	 * matches the output's last commanded state is skipped, unless it's been
+	 * refreshMs since it was last sent (0 to never re-send).  That state is
+	 * the one last sent, or the one still queued to go out, if any.
+	 * commandsSuppressed() counts the sends saved.
+	 */
+	void setCommandSuppression(Suppression::Policy policy,
+			uint32_t refreshMs=COMMAND_STATE_REFRESH_DEFAULT_MS);
+	Suppression::Policy commandSuppression() { return (Suppression::Policy)suppression_policy;}
+	uint32_t commandsSuppressed() { return commands_suppressed;}
+	void resetCommandsSuppressed() { commands_suppressed = 0;}
+	// forget the commanded output states, so the next command for each is sent
+	void invalidateOutputStates();
+#endif
+	static Priority::Level priorityFor(DataLink::RequestCode reqCode);
 
+	uint8_t queuedRequests() { return num_queued;}
 
+	// wait, while checking activity, until everything queued is sent
+	// (returns true) or timeoutMs has elapsed (returns false).
+	bool flushRequests(uint16_t timeoutMs);
+
+
+	// queues a WakeUp, unless the EVO-All is known to be awake
+	// (see EVOLINK_AWAKE_WINDOW_MS) or one is already queued.
 	bool wakeUp();
 
+	// with auto wake-up (the default), commands that would reach
+	// a dozing EVO-All are preceded by a WakeUp, so you needn't
+	// bother with wakeUp() at all.
+	void setAutoWakeUp(bool enable) { auto_wakeup = enable;}
+	bool autoWakeUp() { return auto_wakeup;}
+	// keep the EVO-All awake for up to ms after the last command
+	// (0 to let it sleep as soon as it likes)
+	void setKeepAliveMs(uint16_t ms) { keepalive_ms = ms;}
+	// how long the EVO-All stays awake after hearing from us
+	// (0: it never dozes off, once woken up)
+	void setAwakeWindowMs(uint16_t ms) { awake_window_ms = ms;}
+	// whether, as far as we know, the EVO-All is awake
+	bool deviceAwake();
+
+	/*
+	 * Command sequences (see SequenceStep, in types.h).  The sequence
+	 * runs in the background, from checkActivity()/serviceDeadlines(),
+	 * and onDone (if any) is called when it completes or fails.  One
+	 * sequence runs at a time: starting another aborts the current one.
+	 * runSequence() takes steps in RAM, runSequence_P() steps in flash
+	 * (PROGMEM); either way, the steps must stay around until it's done.
+	 * Aborting drops any of the sequence's commands still queued.
+	 * onDone may also be passed the link and a context.
+	 */
+	bool runSequence(const SequenceStep * steps, SequenceCompletionHandler onDone=NULL);
+	bool runSequence_P(const SequenceStep * steps, SequenceCompletionHandler onDone=NULL);
+	bool runSequence(const SequenceStep * steps,
+			SequenceCompletionCallback::ContextFunction onDone, void * context);
+	bool runSequence_P(const SequenceStep * steps,
+			SequenceCompletionCallback::ContextFunction onDone, void * context);
+	void abortSequence();
+	bool sequenceRunning() { return seq_steps != NULL;}
+
 
 	/* request shortcut methods
 	 * Most of these offer two methods of access:
@@ -188,16 +366,42 @@ public:
 	// the request simply performs the request -- it is asynchronous.
 	// Your callbacks.requested_data_received callback
 	// function will be called whenever the response comes in.
-	bool requestTach();
-	bool requestVSS();
-	bool requestStatus();
-	bool requestTemperature();
+	// Each returns a RequestHandle (false if the request couldn't be
+	// made) which you may poll, wait on or attach a completion handler to:
+	//
+	//	RequestHandle h = EVO.requestTach();
+	//	...
+	//	if (EVO.statusOf(h) == Request::Complete)
+	//		rpm = EVO.valueOf(h);
+	//
+	// Handles come from a fixed pool of EVOLINK_REQUEST_POOL_SIZE, and a
+	// finished request's slot is recycled when a new request needs it.
+	RequestHandle requestTach();
+	RequestHandle requestVSS();
+	RequestHandle requestStatus();
+	RequestHandle requestTemperature();
+	RequestHandle requestData(DataLink::RequestCode reqCode,
+			RequestCompletionHandler onDone=NULL, uint16_t expiresInMs=0);
+
+	Request::Status statusOf(RequestHandle handle);
+	int valueOf(RequestHandle handle); // -1 unless Complete
+	// call onDone when the request is done (right away, if it is already).
+	// With a context, onDone is also passed the link and context.
+	bool onComplete(RequestHandle handle, RequestCompletionHandler onDone);
+	bool onComplete(RequestHandle handle,
+			RequestCompletionCallback::ContextFunction onDone, void * context);
+	// wait, while checking activity, until the request is done or
+	// timeoutMs elapses.  Returns true if Complete.
+	bool waitFor(RequestHandle handle, uint16_t timeoutMs);
+	// stop caring about a request: it's dropped if still queued,
+	// and no one will be notified when it completes.
+	void cancel(RequestHandle handle);
 
 	/*
 	 * The following getXXX() utility methods are, unlike their corresponding requestXXX() versions
 	 * above, synchronous -- they will bypass using any callbacks.requested_data_received callback
 	 * specified and will instead await a response for (up to) timeout ms and either return it
-	 * or return -1 on failure.
+	 * (as soon as it arrives) or return -1 on failure.
 	 */
 	int16_t getTach(uint16_t timeout = SYNCHRONOUS_GETTER_DEFAULT_TIMEOUT_MS);
 	int16_t getVSS(uint16_t timeout = SYNCHRONOUS_GETTER_DEFAULT_TIMEOUT_MS) ;
@@ -205,66 +409,300 @@ public:
 			SYNCHRONOUS_GETTER_DEFAULT_TIMEOUT_MS);
 
 
+	// getStatus() answers from the cached input state (see status(), below)
+	// when it's fresh, and only does a Request_Input round trip otherwise.
 	InputStatus getStatus(uint16_t timeout=SYNCHRONOUS_GETTER_DEFAULT_TIMEOUT_MS);
 
+	/*
+	 * Cached input state, kept current from door/hood/trunk/brake/tach
+	 * events and Request_Input responses.  status() never touches the
+	 * line: the result is only valid if every field was updated within
+	 * maxAgeMs (0 meaning any age will do).
+	 */
+	InputStatus status(uint32_t maxAgeMs=EVOLINK_INPUT_STATUS_MAX_AGE_MS);
+	// ms since field was last updated, false if it never was
+	bool statusAge(Input::Field field, uint32_t & ageMs);
+	// forget what we know, so the next getStatus() asks the EVO-All
+	void invalidateStatus();
+	// when the serial port reports incoming bytes were lost (see
+	// SerialConnection::rxOverruns()), the driver does the above,
+	// queues a Request_Input to get back in sync, and notifies
+	// callbacks.error_event with ErrorMessage::RxOverrun.
+
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+	/*
+	 * Deferred events.  checkActivity() (and anything else that parses
+	 * incoming bytes) only queues events, errors and finished data
+	 * requests, which reach your callbacks, custom handlers, subscribers
+	 * and request completion handlers when you call dispatchPending(),
+	 * oldest first.  It delivers at most maxEvents and returns how many
+	 * it did, so you may bound the time spent in callbacks.  Driver state
+	 * (input cache, sequences, statusOf()/valueOf()) is still updated as
+	 * bytes come in.
+	 *
+	 * When the queue is full, newly arrived events are dropped, and
+	 * counted in eventQueueStatus().dropped.  Finished requests are never
+	 * dropped: those that don't fit are delivered once the queue is empty.
+	 */
+	uint16_t dispatchPending(uint16_t maxEvents=EVOLINK_EVENT_QUEUE_SIZE);
+	uint16_t pendingEvents() { return event_queue_status.pending;}
+	const EventQueueStatus & eventQueueStatus() { return event_queue_status;}
+	void resetEventQueueStatus();
+#endif
+
+#ifdef EVOLINK_TRACE_ENABLE
+	/*
+	 * Trace ring (see TraceRecord, in types.h).  drainTrace() pops the
+	 * oldest record, returning false when there are none left.  When
+	 * the ring is full, new records overwrite the oldest ones:
+	 * traceRecordsLost() counts those.  dumpTrace() drains the lot to
+	 * the debug usart, so call it when the link is idle.
+	 */
+	bool drainTrace(TraceRecord & rec);
+	uint16_t traceRecordsLost() { return trace_lost;}
+#ifdef DEBUG_USART_ENABLE
+	void dumpTrace();
+#endif
+#endif
+
+#ifdef EVOLINK_STATISTICS_ENABLE
+	/*
+	 * Link statistics (see LinkStatistics, in types.h), since
+	 * construction or the last resetStatistics().
+	 * latencyBucketMaxMs() is the upper bound of a latency bucket, 0
+	 * for the last (open-ended) one.
+	 */
+	const LinkStatistics & statistics() { return stats;}
+	void resetStatistics();
+	static uint16_t latencyBucketMaxMs(uint8_t bucket);
+#endif
+
 	int16_t synch_getter_value_received;
 
 
 private:
 	SerialSetup serial_setup;
+	SerialConnection serial;
+	Clock * clock_src;
+
+	// the driver's notion of time: these stand in for the platform's
+	// timeMs() & co., so everything EvoAll does goes through clock_src.
+	uint32_t timeMs() { return clock_src->nowMs(); }
+	void delayMs(uint16_t ms) { clock_src->delayMs(ms); }
+	void delayUs(uint16_t us) { clock_src->delayUs(us); }
+
 	/* a few structure used internally */
-	typedef struct DLMessageCodeToCallbackAssociationStruct {
-		uint8_t raw_msg_code;
-		GenericMessageHandler callback;
-		DLMessageCodeToCallbackAssociationStruct(DataLink::MessageCode msg,
-				GenericMessageHandler cb) :
-				raw_msg_code((uint8_t) msg), callback(cb) {
 
-		}
+	// message families, i.e. which of the callbacks gets a message
+	typedef enum MessageFamilyEnum {
+		Family_RemoteStarter = 0,
+		Family_OpenClose,
+		Family_Brake,
+		Family_Sensor,
+		Family_Tach,
+		Family_Generic,
+		Family_Error
+	} MessageFamily;
+
+	typedef struct DLMessageCodeToFamilyAssociationStruct {
+		uint8_t raw_msg_code;
+		uint8_t family;
+	} MessageCodeFamily;
 
-	} MessageCodeCallback;
 	typedef int (*QueryResponseDataProcessor)(
 			EvoLink::DataLink::RequestCode request, uint8_t returnedValue);
 	typedef struct DLRequestWithResponseStruct {
 		DataLink::RequestCode req;
 		QueryResponseDataProcessor processor;
-		DLRequestWithResponseStruct(DataLink::RequestCode r,
-				QueryResponseDataProcessor massager = NULL) :
-				req(r), processor(massager) {
-
-		}
 	} RequestWithResponse;
 
-	/* associations between message codes and callbacks */
-	static MessageCodeCallback callback_assocs[];
-	/* list of requests that return a response */
-	static RequestWithResponse reqs_with_responses[];
+	typedef struct DLOutputPairStruct {
+		uint8_t on;
+		uint8_t off;
+	} OutputPair;
+
+	/* code -> family/response processor lookup tables (shared by all instances),
+	 * generated at compile time in driver.cpp */
+	struct DispatchTables;
+
+
+	int8_t messageIndexFor(uint8_t raw_msg_code);
+	void dispatchToCallbacks(uint8_t family, uint8_t msgcode);
+	void deliverMessage(int8_t idx, uint8_t msgcode);
+	void notifyError(ErrorMessage::Event event, uint8_t param);
+
+	const RequestWithResponse * reqWithResponseEntryFor(DataLink::RequestCode c);
+
+	/* data request pool */
+	typedef struct DataRequestStruct {
+		uint8_t req;
+		uint8_t status;
+		uint8_t generation;
+		bool notify_callbacks; // call callbacks.requested_data_received
+		int value;
+		uint32_t issue_time;
+		RequestCompletionCallback on_complete;
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+		bool notify_pending; // finished, handlers waiting on dispatchPending()
+#endif
+	} DataRequest;
+
+	DataRequest * requestFor(RequestHandle handle);
+	int8_t allocateRequest();
+	int8_t newRequest(DataLink::RequestCode reqCode, const RequestCompletionCallback & onDone,
+			bool notifyCallbacks);
+	bool setCompletion(RequestHandle handle, const RequestCompletionCallback & onDone);
+	RequestHandle submitRequest(DataLink::RequestCode reqCode, Priority::Level priority,
+			uint16_t expiresInMs, const RequestCompletionCallback & onDone, bool notifyCallbacks,
+			bool fromSequence=false);
+	void finishRequest(uint8_t slot, Request::Status status, int value=-1);
+	void notifyCompletion(DataRequest & r);
+	void requestSent(uint8_t slot);
+	bool requestInFlight(uint8_t slot);
+
+	// false if the byte couldn't be written
+	bool sendRequest(DataLink::RequestCode reqCode, bool wasPaced=false);
+	void markTransmitted(DataLink::RequestCode reqCode, bool wasPaced);
+
+	/* command queue */
+	typedef struct QueuedCommandStruct {
+		uint8_t req;
+		uint8_t request_slot; // data request pool slot, or 0xff
+		bool from_sequence;
+#if defined(EVOLINK_STATISTICS_ENABLE) || defined(EVOLINK_TRACE_ENABLE)
+		uint32_t queued_time;
+#endif
+		uint8_t priority;
+		bool expires;
+		uint32_t expiry_time;
+	} QueuedCommand;
+
+	bool canTransmit();
+	uint32_t nextTransmitTime();
+	void pumpQueue();
+	int8_t nextQueuedCommand(); // index in command_queue, or -1
+	static bool answeredAtOnce(uint8_t reqCode);
+	bool slowAnswerInFlight();
+	bool enqueue(DataLink::RequestCode reqCode, Priority::Level priority,
+			uint16_t expiresInMs, uint8_t requestSlot, bool fromSequence=false);
+	bool queueCommand(DataLink::RequestCode reqCode, Priority::Level priority,
+			uint16_t expiresInMs, bool force, bool fromSequence);
 
 
-	bool parseMessage(int msg);
-	MessageCodeCallback * codeToCallbackEntryFor(uint8_t raw_msg_code);
+	int16_t synchronousGet(uint16_t timeout, DataLink::RequestCode code);
 
-	RequestWithResponse * reqWithResponseEntryFor(DataLink::RequestCode c);
 
-	void prepareRequestNeedingResponse(RequestWithResponse * setup);
-	void resetPendingRequest();
+	/* per-instance custom handlers, only for the messages overridden */
+	typedef struct CustomHandlerStruct {
+		uint8_t msg_idx; // as DispatchTables::message_families[]
+		GenericMessageCallback handler;
+	} CustomHandler;
 
-	void sendRequest(DataLink::RequestCode reqCode);
+	CustomHandler * customHandlerFor(int8_t idx);
+	bool setCustomHandler(int8_t idx, const GenericMessageCallback & handler);
+	CustomHandler custom_handlers[EVOLINK_MAX_CUSTOM_HANDLERS];
+	uint8_t num_custom_handlers;
 
+#ifdef EVOLINK_EVENT_BUS_ENABLE
+	int8_t freeSubscriberSlot();
+	void publish(int8_t idx, uint8_t msgcode);
 
-	int16_t synchronousGet(uint16_t timeout, DataLink::RequestCode code);
-	void synchronousValueGetterSetup();
-	void synchronousValueGetterTeardown();
+	GenericMessageCallback subscribers[EVOLINK_MAX_SUBSCRIBERS];
+	// bit i set: subscribers[i] wants the message, indexed as message_families[]
+	uint8_t subscribed[EVOLINK_NUM_SUPPORTED_MESSAGES];
+#endif
 
-	RequestWithResponse * pending_request_response;
-	uint32_t pending_request_issue_time;
+	DataRequest requests[EVOLINK_REQUEST_POOL_SIZE];
+	uint8_t inflight[EVOLINK_MAX_INFLIGHT_REQUESTS]; // request slots, in order of issue
+	uint8_t num_inflight;
+	uint8_t next_request_slot;
 #ifdef MINTIME_BETWEEN_WAKEUPS_MS
 	uint32_t last_wakeup_time;
 #endif
 	uint32_t last_tx_time;
+	uint32_t last_command_time; // last TX other than WakeUp
+	bool tx_since_begin; // last_tx_time means something
+	bool auto_wakeup;
+	uint16_t awake_window_ms;
+	uint16_t keepalive_ms;
+	bool keepAliveDue(uint32_t & when);
 	uint8_t auto_delay_ms;
+	uint16_t post_tx_delay_ms; // min delay after last_tx_time, before next send
+
+	QueuedCommand command_queue[EVOLINK_COMMAND_QUEUE_SIZE]; // in order of submission
+	uint8_t num_queued;
+
+#ifdef EVOLINK_COMMAND_SUPPRESSION_ENABLE
+	/* commanded output states, indexed as DispatchTables::output_pairs[] */
+	bool suppressRedundant(uint8_t outputEntry);
+	void recordOutput(uint8_t outputEntry);
+	uint8_t outputEntryFor(uint8_t reqCode);
+	uint8_t output_state[EVOLINK_NUM_OUTPUT_PAIRS];
+	uint32_t output_sent_time[EVOLINK_NUM_OUTPUT_PAIRS];
+	uint8_t suppression_policy;
+	uint32_t state_refresh_ms;
+	uint32_t commands_suppressed;
+#endif
 
-	QueryResponseHandler user_specified_handler; // used as swap space for synchronous getters
+	/* command sequence */
+	bool startSequence(const SequenceStep * steps, bool inFlash,
+			const SequenceCompletionCallback & onDone);
+	void serviceSequence();
+	void finishSequence(Sequence::Result result);
+	bool sequenceCommandQueued();
+	const SequenceStep * seq_steps; // NULL when not running
+	bool seq_in_flash;
+	uint8_t seq_index;
+	bool seq_step_started;
+	bool seq_msg_seen;
+	SequenceStep seq_step; // current step
+	uint32_t seq_step_start;
+	SequenceCompletionCallback seq_done;
+
+#ifdef EVOLINK_EVENT_QUEUE_ENABLE
+	bool deferEvent(Deferred::Kind kind, uint8_t code, int value,
+			RequestHandle request=RequestHandle());
+	PendingEvent event_queue[EVOLINK_EVENT_QUEUE_SIZE];
+	uint8_t event_queue_head;
+	EventQueueStatus event_queue_status;
+#endif
+
+#ifdef EVOLINK_TRACE_ENABLE
+	void trace(uint8_t decision, uint8_t data)
+	{
+		TraceRecord & rec = trace_ring[trace_head++ & (EVOLINK_TRACE_SIZE - 1)];
+		rec.time_ms = (uint16_t)timeMs();
+		rec.data = data;
+		rec.decision = decision;
+		if (trace_count < EVOLINK_TRACE_SIZE)
+			trace_count++;
+		else
+			trace_lost++;
+	}
+	TraceRecord trace_ring[EVOLINK_TRACE_SIZE];
+	uint8_t trace_head;
+	uint16_t trace_count;
+	uint16_t trace_lost;
+#endif
+
+#ifdef EVOLINK_STATISTICS_ENABLE
+	void recordLatency(uint8_t reqCode, uint32_t latencyMs);
+	LinkStatistics stats;
+#endif
+
+	/* overrun detection */
+	void checkOverruns();
+	void queueResync();
+	uint16_t rx_overruns_seen;
+	RequestHandle resync_request;
+	bool resync_pending; // Request_Input yet to be accepted by the queue
+
+	/* input state cache */
+	void updateInputCache(uint8_t msgcode);
+	void updateInputField(Input::Field field, bool set);
+	InputStatus input_cache;
+	uint32_t input_update_time[Input::NumFields];
+	uint8_t input_fields_known; // bit per Input::Field
 
 
 };
@@ -272,9 +710,11 @@ private:
 } /* namespace EvoLink */
 
 
+#ifndef EVOLINK_NO_DEFAULT_INSTANCE
 // This is the main, global, EVO object, used
 // in your code.
 extern EvoLink::EvoAll EVO;
+#endif
 
 
 #endif /* DRIVER_H_ */
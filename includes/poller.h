@@ -0,0 +1,112 @@
+/*
+ * poller.h -- Telemetry poller for EvoLink, part of the
+ * cross-platform EVO-All interface library.
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Poller -- keeps tach, VSS, temperature and/or input status samples
+ * coming at the rates you ask for.
+ *
+ * 	EvoLink::Poller poller(EVO);
+ * 	poller.setPeriod(DataLink::Request_Tach, 200);			// 5 Hz
+ * 	poller.setPeriod(DataLink::Request_VSS, 500);			// 2 Hz
+ * 	poller.setPeriod(DataLink::Request_Temperature, 30000);	// every 30s
+ *
+ * 	loop() {
+ * 		EVO.checkActivity();
+ * 		poller.service();
+ * 	}
+ *
+ * Samples are delivered as usual, through callbacks.requested_data_received.
+ * Requests are only issued when the driver has room for them (in-flight
+ * window and command queue), one outstanding per signal, and go out at
+ * Telemetry priority, paced like everything else.  If the link can't keep
+ * up, every signal is slowed down in proportion to its period, rather than
+ * starving the slower ones, and achievedRateMilliHz() tells you what you
+ * are actually getting.
+ *
+ */
+
+#ifndef EVOLINK_POLLER_H_
+#define EVOLINK_POLLER_H_
+
+#include "driver.h"
+
+// number of signals a Poller can track (one per data request code)
+#define EVOLINK_POLLER_MAX_SIGNALS		4
+
+namespace EvoLink {
+
+class Poller {
+public:
+	Poller(EvoAll & evoall);
+
+	// poll code (Request_Tach, Request_VSS, Request_Temperature or
+	// Request_Input) every periodMs.  A period of 0 stops polling it.
+	bool setPeriod(DataLink::RequestCode code, uint32_t periodMs);
+
+	// issue whatever requests are due; call this often (e.g. right
+	// after checkActivity()).
+	void service();
+
+	// rate actually achieved (mHz, so 5Hz == 5000), 0 until we've
+	// got a couple of samples.
+	uint32_t achievedRateMilliHz(DataLink::RequestCode code);
+	uint32_t samples(DataLink::RequestCode code);
+	uint32_t failures(DataLink::RequestCode code); // timed out or dropped
+
+	// true if every signal is getting at least pct % of its target rate
+	bool onTarget(uint8_t pct=90);
+
+	// forget achieved rates and counts
+	void resetStats();
+
+private:
+	typedef struct PolledSignalStruct {
+		uint8_t req;
+		uint32_t period_ms;
+		uint32_t next_due;
+		RequestHandle outstanding;
+		uint32_t last_sample_time;
+		uint32_t avg_interval_ms;
+		uint32_t num_samples;
+		uint32_t num_failures;
+	} PolledSignal;
+
+	PolledSignal * signalFor(DataLink::RequestCode code);
+	void collect(PolledSignal & sig, Request::Status status);
+	static void requestDone(EvoAll & link, void * context,
+			DataLink::RequestCode request, Request::Status status, int value);
+
+	EvoAll & evo;
+	PolledSignal signals[EVOLINK_POLLER_MAX_SIGNALS];
+	uint8_t num_signals;
+
+};
+
+} /* namespace EvoLink */
+
+#endif /* EVOLINK_POLLER_H_ */
@@ -0,0 +1,117 @@
+/*
+ * epoll_reactor.h -- Multi-link event loop for EvoLink, part of the
+ * cross-platform EVO-All interface library.
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Reactor -- a single-threaded event loop that drives many EvoAll
+ * links at once, on Linux.
+ *
+ * Rather than calling checkActivity() on every link in turn (which
+ * polls each serial port and busy-waits between bytes), the reactor
+ * registers every link's file descriptor with epoll and keeps a
+ * min-heap of each link's next deadline (as reported by
+ * EvoAll::nextDeadline()).  A link is only touched when bytes
+ * arrive for it (processIncoming()) or when its deadline fires
+ * (serviceDeadlines()).  Deadlines are read off each link's own clock
+ * (see EvoAll::setClock()) and waited for in real time.
+ *
+ * 	EvoAll links[NUM_LINKS];
+ * 	Reactor reactor(NUM_LINKS);
+ *
+ * 	for (...) {
+ * 		links[i].begin(SerialSetup(tty_path[i]));
+ * 		reactor.add(&links[i]);
+ * 	}
+ *
+ * 	while (running)
+ * 		reactor.runOnce(100);
+ *
+ * If you issue requests on a link from outside the reactor's own
+ * callbacks, call reschedule() for that link so the reactor learns
+ * about its new deadline.
+ *
+ */
+
+#ifndef EVOLINK_EPOLL_REACTOR_H_
+#define EVOLINK_EPOLL_REACTOR_H_
+
+#include "../driver.h"
+
+#if defined(PLATFORM_POSIX) && defined(__linux__)
+
+namespace EvoLink {
+
+class Reactor {
+public:
+	Reactor(uint16_t max_links);
+	~Reactor();
+
+	// add/remove links -- add() fails if we're full or the
+	// link has no open serial port.
+	bool add(EvoAll * link);
+	bool remove(EvoAll * link);
+
+	// re-read the link's nextDeadline(), e.g. after making a request.
+	void reschedule(EvoAll * link);
+
+	// wait (up to max_wait_ms, or until the next deadline, -1 for
+	// no limit) for activity and service whatever's ready.
+	// Returns the number of link services performed.
+	uint16_t runOnce(int max_wait_ms=-1);
+
+	uint16_t numLinks() { return num_links; }
+
+private:
+	typedef struct ReactorLinkStruct {
+		EvoAll * link;
+		uint32_t deadline; // on our timeMs(), whatever the link's clock
+		int32_t heap_pos; // -1 when not scheduled
+	} ReactorLink;
+
+	int16_t slotFor(EvoAll * link);
+	void updateSchedule(uint16_t slot);
+
+	/* deadline min-heap of slot indices */
+	bool earlier(uint16_t slotA, uint16_t slotB);
+	void heapSwap(uint16_t posA, uint16_t posB);
+	void heapUp(uint16_t pos);
+	void heapDown(uint16_t pos);
+	void heapRemove(uint16_t slot);
+
+	int epoll_fd;
+	uint16_t capacity;
+	uint16_t num_links;
+	ReactorLink * links;
+	uint16_t * heap;
+	uint16_t heap_size;
+};
+
+} /* namespace EvoLink */
+
+#endif /* PLATFORM_POSIX && __linux__ */
+
+#endif /* EVOLINK_EPOLL_REACTOR_H_ */
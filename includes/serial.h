@@ -34,6 +34,9 @@
  *  Each platform will have its own definition of the SerialSetup parameters,
  *  passed to setup, but otherwise this class will mask differences between
  *  platforms for code at higher levels.
+ *
+ *  Each SerialConnection instance owns its own port, so you may have as
+ *  many as the platform has USARTs/ttys to offer.
  */
 
 #ifndef EVOLINK_SERIAL_H_
@@ -45,19 +48,77 @@
 #include "serial/arduino_serial.h"
 #endif
 
-namespace EvoLink {
+#ifdef PLATFORM_POSIX
+#include "serial/posix_serial.h"
+#endif
 
+#ifdef EVOLINK_RX_RING_ENABLE
+#include "serial/rx_ring.h"
+#endif
 
+namespace EvoLink {
+
+#ifdef PLATFORM_POSIX
+class SessionRecorder;
+#endif
 
 class SerialConnection {
 public:
-	static void setup(SerialSetup & params);
+	SerialConnection() : port(EVOLINK_SERIALPORT_NONE), owns_port(false),
+		char_time_us(0), rx_overruns(0)
+#ifdef PLATFORM_POSIX
+		, recorder(NULL)
+#endif
+	{}
+	~SerialConnection() { end(); }
+
+	// returns false if the port couldn't be set up as asked
+	bool setup(SerialSetup & params);
+	// let go of the port, closing (or ending) it if setup() opened
+	// (or began) it.
+	void end();
 
-	static size_t write(uint8_t c);
+	size_t write(uint8_t c);
 
-	static int available();
-	static int read();
+	int available();
+	int read();
 
+	// read up to max bytes that are already waiting, without blocking.
+	// returns number of bytes read.
+	size_t readBytes(uint8_t * buf, size_t max);
+
+	// wait (up to timeoutUs) for incoming data, returning as soon
+	// as there's something to read.  Returns true if there is.
+	bool waitForData(uint32_t timeoutUs);
+
+	// time it takes a single byte to cross the wire, given
+	// the baud rate and frame format from setup().
+	uint32_t characterTimeUs() { return char_time_us; }
+
+	// the underlying port (HardwareSerial*, file descriptor...)
+	SerialPort handle() { return port; }
+
+	// number of receive overruns (bytes lost, or that may have been)
+	// detected since setup(), where the platform can tell: the tty
+	// driver's error counters on Linux, the receive buffer being found
+	// full with HardwareSerial, or the RX ring filling up (or the USART
+	// overrunning) with EVOLINK_RX_RING_ENABLE.  Wraps at 0xffff.
+	uint16_t rxOverruns();
+
+#ifdef PLATFORM_POSIX
+	// log every byte read/written to rec (NULL to stop)
+	void setRecorder(SessionRecorder * rec) { recorder = rec; }
+#endif
+
+private:
+	SerialPort port;
+	bool owns_port; // we opened/began it, so we close/end it
+	uint32_t char_time_us;
+	// Arduino: count so far, POSIX: the tty's count at setup()
+	uint32_t rx_overruns;
+#ifdef PLATFORM_POSIX
+	SessionRecorder * recorder;
+#endif
 
 };
 
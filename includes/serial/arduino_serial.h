@@ -40,6 +40,10 @@
 
 namespace EvoLink {
 
+// SerialPort -- what a SerialConnection holds on to, on this platform
+typedef HardwareSerial * SerialPort;
+#define EVOLINK_SERIALPORT_NONE		NULL
+
 class SerialSetup {
 public:
 	SerialSetup(HardwareSerial * serial_conn, uint32_t baud=BAUDRATE_DEFAULT, bool call_begin=true, uint8_t config_byte=SERIAL_8N1) :
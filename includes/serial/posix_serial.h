@@ -0,0 +1,83 @@
+/*
+ * posix_serial.h -- POSIX Serial for EvoLink, part of the
+ * cross-platform EVO-All interface library.
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * SerialSetup type implementation to use on POSIX systems.
+ *
+ * The EVO-All is reached through a tty device (e.g. a USB-serial
+ * adapter on /dev/ttyUSB0).  By default, SerialConnection::setup()
+ * will open the device and configure it as raw 8N1 at baud_rate, and
+ * SerialConnection::end() (or EvoAll::end()) closes it again.
+ * If you already have a descriptor (say, the slave side of a
+ * pseudo-terminal pair), pass that instead of the device path.
+ * Only the standard termios rates are supported: setup() (and so
+ * EvoAll::begin()) fails on any other baud rate, or if the device
+ * can't be opened or configured.
+ *
+ */
+
+#ifndef EVOLINK_POSIX_SERIAL_H_
+#define EVOLINK_POSIX_SERIAL_H_
+
+#include "../dependencies.h"
+
+#ifdef PLATFORM_POSIX
+
+namespace EvoLink {
+
+// SerialPort -- what a SerialConnection holds on to, on this platform
+typedef int SerialPort;
+#define EVOLINK_SERIALPORT_NONE		-1
+
+class SerialSetup {
+public:
+	SerialSetup(const char * device_path, uint32_t baud=BAUDRATE_DEFAULT, bool call_begin=true) :
+		baud_rate(baud), device(device_path), fd(-1), do_begin(call_begin)
+	{
+
+	}
+	SerialSetup(int open_fd, uint32_t baud=BAUDRATE_DEFAULT, bool call_begin=true) :
+		baud_rate(baud), device(NULL), fd(open_fd), do_begin(call_begin)
+	{
+
+	}
+
+	uint32_t			baud_rate;
+	const char *		device;
+	int					fd;
+	// do_begin: configure the tty (raw, 8N1, baud_rate) on setup
+	bool 				do_begin;
+
+};
+
+
+} /* namespace EvoLink */
+
+#endif /* PLATFORM_POSIX */
+
+#endif /* EVOLINK_POSIX_SERIAL_H_ */
@@ -0,0 +1,151 @@
+/*
+ * rx_ring.h -- Interrupt-safe receive ring for EvoLink, part of the
+ * cross-platform EVO-All interface library.
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * RxRing -- lock-free, single-producer/single-consumer byte ring.
+ *
+ * The producer (on AVR, the USART RX interrupt, see EVOLINK_RX_RING_ENABLE
+ * in config.h) push()es bytes as they arrive; the consumer (the driver,
+ * through SerialConnection) reads them out.  Neither side ever waits on the
+ * other: head is only written by the producer and tail by the consumer, so
+ * nothing needs to be locked or have interrupts turned off.  When the ring
+ * is full, push() drops the byte and counts an overrun.
+ *
+ * SIZE must be a power of 2, 128 at most (indices run free in a uint8_t).
+ *
+ * Nothing in here is AVR-specific, so the ring may be exercised on a
+ * desktop, with a thread standing in for the interrupt (see
+ * extras/bench/rx_ring.cpp).
+ *
+ */
+
+#ifndef EVOLINK_RX_RING_H_
+#define EVOLINK_RX_RING_H_
+
+#include "../dependencies.h"
+
+namespace EvoLink {
+
+template<uint8_t SIZE>
+class RxRing {
+public:
+	static_assert(SIZE && !(SIZE & (SIZE - 1)) && SIZE <= 128,
+			"RxRing SIZE must be a power of 2, 128 at most");
+
+	RxRing() : head(0), tail(0), overrun_count(0) {}
+
+	/*
+	 * producer side
+	 */
+	// store b, returning false (and counting an overrun) if the ring is full
+	bool push(uint8_t b)
+	{
+		uint8_t h = head; // ours
+		if ((uint8_t)(h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) >= SIZE)
+		{
+			overrun_count++;
+			return false;
+		}
+
+		buf[h & (SIZE - 1)] = b;
+		__atomic_store_n(&head, (uint8_t)(h + 1), __ATOMIC_RELEASE);
+		return true;
+	}
+
+	// count a byte lost before it got to us
+	void noteOverrun()
+	{
+		overrun_count++;
+	}
+
+	// true if push() would drop the byte
+	bool full() const
+	{
+		return (uint8_t)(head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) >= SIZE;
+	}
+
+	/*
+	 * consumer side
+	 */
+	uint8_t available() const
+	{
+		return (uint8_t)(__atomic_load_n(&head, __ATOMIC_ACQUIRE) - tail);
+	}
+
+	// next byte, or -1 if there's none
+	int read()
+	{
+		uint8_t t = tail; // ours
+		if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) == t)
+			return -1;
+
+		uint8_t b = buf[t & (SIZE - 1)];
+		__atomic_store_n(&tail, (uint8_t)(t + 1), __ATOMIC_RELEASE);
+		return b;
+	}
+
+	// read up to max bytes, returning how many were
+	size_t readBytes(uint8_t * dest, size_t max)
+	{
+		uint8_t t = tail;
+		uint8_t num = (uint8_t)(__atomic_load_n(&head, __ATOMIC_ACQUIRE) - t);
+		if (num > max)
+			num = max;
+
+		for (uint8_t i=0; i < num; i++)
+			dest[i] = buf[(uint8_t)(t + i) & (SIZE - 1)];
+
+		// only now may the producer reuse the space
+		__atomic_store_n(&tail, (uint8_t)(t + num), __ATOMIC_RELEASE);
+		return num;
+	}
+
+	// bytes dropped because the ring was full (or noted by the
+	// producer), since construction.  Wraps at 0xffff, so compare
+	// readings by their difference.
+	// The producer may be updating the count as we read it, and it
+	// can't be read in one go on 8-bit targets: read until it holds still.
+	uint16_t overruns() const
+	{
+		uint16_t count;
+		do {
+			count = overrun_count;
+		} while (count != overrun_count);
+		return count;
+	}
+
+private:
+	uint8_t buf[SIZE];
+	uint8_t head;	// written by the producer only
+	uint8_t tail;	// written by the consumer only
+	volatile uint16_t overrun_count; // producer only, too
+};
+
+} /* namespace EvoLink */
+
+#endif /* EVOLINK_RX_RING_H_ */
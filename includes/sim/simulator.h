@@ -0,0 +1,190 @@
+/*
+ * simulator.h -- Host-side EVO-All simulator for EvoLink, part of the
+ * cross-platform EVO-All interface library.
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * ************************* OVERVIEW *************************
+ *
+ * Simulator -- the EVO-All's side of the link, for host-side testing.
+ *
+ * This is the logic of examples/EvoAllSimulator, minus the Arduino pins,
+ * SerialUI and global state: it takes request bytes in, and gives
+ * response and event bytes back, so a driver can be exercised (and
+ * load-tested) with no hardware at all.  Like the real thing, it
+ *
+ *  - ignores commands unless it was woken up (WakeUp, or another
+ *    command) within the wake timeout;
+ *  - answers input status, ping and pong right away, and tach, VSS and
+ *    temperature requests after a configurable delay (drawn from a
+ *    range), so answers needn't come back in the order asked;
+ *  - takes its time with requests that come in too close together,
+ *    handling each at least a minimum gap after the last;
+ *  - keeps an InputStatus model up to date, and may emit random events
+ *    at a set interval, consistent with that state (no "door opened"
+ *    while it's already open) unless you ask otherwise.
+ *
+ * Randomness comes from its own generator, so a given seed always
+ * plays out the same way.
+ *
+ * Either shuttle the bytes yourself:
+ *
+ * 	sim.receive(byteFromDriver, timeMs());
+ * 	sim.service(timeMs());
+ * 	while (sim.available())
+ * 		link.parseMessage(sim.read());
+ *
+ * or, with the driver on the other end of a pty or socketpair(), just
+ * call sim.serviceFd(fd, timeMs()) regularly (e.g. from its own thread).
+ *
+ */
+
+#ifndef EVOLINK_SIMULATOR_H_
+#define EVOLINK_SIMULATOR_H_
+
+#include "../driver.h"
+
+#ifdef PLATFORM_POSIX
+
+// defaults, as in the EvoAllSimulator example
+#define SIMULATOR_WAKE_TIMEOUT_MS				300
+#define SIMULATOR_RESPONSE_DELAY_MS				110
+#define SIMULATOR_MIN_REQUEST_GAP_MS			10
+#define SIMULATOR_RANDOM_EVENT_INTERVAL_MS		500
+
+// room for responses not yet due, and bytes not yet read
+#define SIMULATOR_MAX_PENDING_RESPONSES			8
+#define SIMULATOR_OUTPUT_BUFFER_SIZE			64
+
+namespace EvoLink {
+
+class Simulator {
+public:
+	// families of random events (EvoAllSimulator's OUTPUT_RANDOM_EVENTS_*)
+	typedef enum SimEventFamilyEnum {
+		RemoteStarterEvents = 0x01,
+		OpenCloseEvents		= 0x02,
+		BrakeEvents			= 0x04,
+		SensorEvents		= 0x08,
+		TachEvents			= 0x10,
+		MiscEvents			= 0x20,
+		NoEvents			= 0x00,
+		AllEvents			= 0x3f
+	} EventFamily;
+
+	Simulator(uint32_t seed=1);
+
+	// restart the random sequence (random events, response delays and values)
+	void seed(uint32_t seed);
+
+	/* configuration */
+	void setWakeTimeoutMs(uint32_t ms) { wake_timeout_ms = ms; }
+	// tach/VSS/temperature responses go out between minMs and maxMs
+	// after the request.
+	void setResponseDelayMs(uint16_t minMs, uint16_t maxMs);
+	// a request that arrives less than ms after the last is handled
+	// (and, if need be, answered) that long after it.
+	void setMinRequestGapMs(uint16_t ms) { min_request_gap_ms = ms; }
+	// random events from families (an EventFamily mask), every intervalMs
+	void setRandomEvents(uint8_t families,
+			uint16_t intervalMs=SIMULATOR_RANDOM_EVENT_INTERVAL_MS);
+	// CONSISTENT_STATE_RANDOM_EVENTS, on by default
+	void setConsistentEvents(bool consistent) { consistent_events = consistent; }
+
+	/* byte in, byte out */
+	void receive(uint8_t reqCode, uint32_t nowMs);
+	// emit any responses and random events that have come due
+	void service(uint32_t nowMs);
+	int available() { return out_count; }
+	int read(); // -1 if there's nothing
+
+	// read any requests waiting on fd, service() and write out whatever
+	// is ready.  fd should be non-blocking.
+	void serviceFd(int fd, uint32_t nowMs);
+
+	/* the car */
+	// pick a random event (from the enabled families) and send it.  With
+	// consistent events, picks that don't fit the current state are
+	// skipped--or, if force is set, another is picked.  Returns true if
+	// something went out.
+	bool sendRandomEvent(bool force=false);
+	// change an input, sending the matching event if it actually changed
+	void setInput(Input::Field field, bool active);
+	// queue a raw byte for the driver
+	void emit(uint8_t code);
+
+	InputStatus inputs() { return input_status; }
+	bool alarmOn() { return alarm_on; }
+	bool hornOn(uint32_t nowMs);
+
+	uint32_t requestsHandled() { return num_handled; }
+	uint32_t requestsRejected() { return num_rejected; } // weren't awake
+	uint32_t bytesDropped() { return num_dropped; } // output buffer full
+
+private:
+	typedef struct PendingResponseStruct {
+		uint8_t req;
+		uint32_t due;
+	} PendingResponse;
+
+	uint32_t random();
+	bool applyEvent(uint8_t msgcode, bool mustChange);
+	void scheduleResponse(uint8_t reqCode, uint32_t due);
+	void respond(uint8_t reqCode);
+
+	uint32_t rand_state;
+
+	uint32_t wake_timeout_ms;
+	uint16_t resp_delay_min;
+	uint16_t resp_delay_max;
+	uint16_t min_request_gap_ms;
+	uint8_t event_families;
+	uint16_t event_interval_ms;
+	bool consistent_events;
+
+	InputStatus input_status;
+	bool alarm_on;
+	bool horn_on;
+	uint32_t horn_off_time; // timed horn, if non-zero
+	bool ever_woken;
+	uint32_t last_req_time; // when the last was handled, which may be to come
+	uint32_t last_event_time;
+
+	PendingResponse pending[SIMULATOR_MAX_PENDING_RESPONSES]; // by due time
+	uint8_t num_pending;
+
+	uint8_t out_buf[SIMULATOR_OUTPUT_BUFFER_SIZE];
+	uint8_t out_head;
+	uint8_t out_count;
+
+	uint32_t num_handled;
+	uint32_t num_rejected;
+	uint32_t num_dropped;
+};
+
+} /* namespace EvoLink */
+
+#endif /* PLATFORM_POSIX */
+
+#endif /* EVOLINK_SIMULATOR_H_ */
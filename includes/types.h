@@ -49,6 +49,84 @@ typedef void (*TachEventHandler)(EvoLink::Tach::Event event);
 typedef void (*ErrorEventHandler)(EvoLink::ErrorMessage::Event event,
 		uint8_t param);
 
+namespace EvoLink {
+namespace Request {
+
+typedef enum RequestStatusEnum {
+	Expired = 0,	// unknown handle, or its slot has since been reused
+	Queued,			// waiting for its turn on the line
+	Pending,		// sent, awaiting response
+	Complete,		// response received, value available
+	TimedOut,		// no response in time
+	Dropped,		// never sent (expired in queue or cancelled)
+	Cancelled		// sent, but the caller lost interest
+} Status;
+
+}
+}
+
+typedef void (*RequestCompletionHandler)(EvoLink::DataLink::RequestCode request,
+		EvoLink::Request::Status status, int value);
+
+/*
+ * Command sequences (macros), run by EvoAll::runSequence() without
+ * blocking.  A sequence is an array of SequenceSteps, ending with
+ * EVOLINK_SEQ_END(), and may live in flash:
+ *
+ *	const EvoLink::SequenceStep armSequence[] PROGMEM = {
+ *		EVOLINK_SEQ_SEND(EvoLink::DataLink::ParkingLight_On),
+ *		EVOLINK_SEQ_SEND(EvoLink::DataLink::StarterKill_On),
+ *		EVOLINK_SEQ_SEND(EvoLink::DataLink::System_Arm),
+ *		EVOLINK_SEQ_SEND(EvoLink::DataLink::Driver1_Lock),
+ *		EVOLINK_SEQ_DELAY(750),
+ *		EVOLINK_SEQ_SEND(EvoLink::DataLink::ParkingLight_Off),
+ *		EVOLINK_SEQ_END()
+ *	};
+ *	...
+ *	EVO.runSequence_P(armSequence, armingDone);
+ *
+ * Each SEND waits for its command to actually go out before moving on,
+ * so delays are relative to the preceding command's transmission.
+ * WAIT_FOR waits (up to timeoutMs, 0 for no limit) for a given
+ * DataLink::MessageCode to come in, e.g. RemoteStarter_On after a
+ * Remote_Start.
+ */
+namespace EvoLink {
+namespace Sequence {
+
+typedef enum SequenceActionEnum {
+	End = 0,
+	Send,		// code: RequestCode
+	Delay,		// ms
+	WaitFor		// code: MessageCode, ms: timeout
+} Action;
+
+typedef enum SequenceResultEnum {
+	Completed = 0,
+	SendFailed,	// command queue full
+	TimedOut,	// WaitFor step timed out
+	Aborted		// abortSequence(), or a new sequence replaced it
+} Result;
+
+}
+
+typedef struct SequenceStepStruct {
+	uint8_t action;
+	uint8_t code;
+	uint16_t ms;
+} SequenceStep;
+
+}
+
+#define EVOLINK_SEQ_SEND(reqcode)				{EvoLink::Sequence::Send, (uint8_t)(reqcode), 0}
+#define EVOLINK_SEQ_DELAY(delayms)				{EvoLink::Sequence::Delay, 0, (delayms)}
+#define EVOLINK_SEQ_WAIT_FOR(msgcode, timeoutms)	{EvoLink::Sequence::WaitFor, (uint8_t)(msgcode), (timeoutms)}
+#define EVOLINK_SEQ_END()						{EvoLink::Sequence::End, 0, 0}
+
+// step is the index of the step that failed (or of the END step)
+typedef void (*SequenceCompletionHandler)(EvoLink::Sequence::Result result,
+		uint8_t step);
+
 namespace EvoLink {
 
 namespace Horn {
@@ -89,6 +167,46 @@ typedef enum StateOpenCloseEnum {
 }
 
 
+namespace Input {
+
+// the fields of an InputStatus, in the order of the
+// bits in Request_Input's response (see InputStatus::asByte())
+typedef enum InputFieldEnum {
+	Door = 0,
+	Hood,
+	Trunk,
+	Tach,
+	HandBrake,
+	Brake,
+	NumFields
+} Field;
+
+}
+
+namespace Suppression {
+
+// what to do with on/off commands that wouldn't change anything,
+// e.g. parklightOn() when we last asked for the parking lights on.
+typedef enum CommandSuppressionEnum {
+	Disabled = 0,	// send everything
+	Enabled			// skip them, re-sending only every refresh interval
+} Policy;
+
+}
+
+namespace Priority {
+
+// order in which queued commands go out--lower goes first,
+// same level goes out in order of submission.
+typedef enum CommandPriorityEnum {
+	WakeUp = 0, // wake-ups go ahead of anything they're meant to wake for
+	Critical,	// safety related, e.g. panic, starter kill, alarm on
+	Normal,
+	Telemetry	// data requests & pings
+} Level;
+
+}
+
 namespace Driver {
 typedef enum {
 	One=1,
@@ -153,44 +271,299 @@ typedef struct InputStatusStruct {
 
 
 
+/*
+ * RequestHandle -- what requestTach() & co. give you back, to
+ * track the data request.  Handles are small values you may copy
+ * around freely; they evaluate to false if the request couldn't
+ * be made.
+ */
+typedef struct RequestHandleStruct {
+	uint8_t slot;
+	uint8_t generation;
+
+	RequestHandleStruct(uint8_t s=0xff, uint8_t gen=0) :
+		slot(s),
+		generation(gen)
+	{
+
+	}
+
+	bool valid() const { return slot != 0xff;}
+	operator bool() const { return valid();}
+
+} RequestHandle;
+
+
+
+class EvoAll;
+
+/*
+ * Callback -- one of the CallbackContainer slots.
+ *
+ * A slot holds either a plain handler, as always:
+ *
+ *	EVO.callbacks.brake_event = myBrakeHandler;
+ *
+ * or a handler that's also passed the EvoAll it came from and a context
+ * pointer of your choosing, so that when running a few links, handlers
+ * needn't go looking for which one fired:
+ *
+ *	void myBrakeHandler(EvoLink::EvoAll & link, void * context,
+ *			EvoLink::Brake::Event event)
+ *	{
+ *		Vehicle * vehicle = (Vehicle*)context;
+ *		...
+ *	}
+ *
+ *	EVO.callbacks.brake_event.set(myBrakeHandler, &vehicle);
+ *
+ * Either way, nothing is allocated, and a slot is just the function and
+ * context pointers.  The same goes for request completion and sequence
+ * completion handlers, and for custom message handlers (see
+ * EvoAll::onComplete(), runSequence() and setHandlerForMessage()).
+ */
+template<typename... Args>
+class Callback {
+public:
+	typedef void (*Function)(Args...);
+	typedef void (*ContextFunction)(EvoAll & link, void * context, Args...);
+
+	Callback() : context(NULL), with_context(false) { fn.plain = NULL; }
+	Callback(Function useFunction) : context(NULL), with_context(false)
+	{
+		fn.plain = useFunction;
+	}
+	Callback(ContextFunction useFunction, void * useContext)
+	{
+		set(useFunction, useContext);
+	}
+
+	Callback & operator=(Function useFunction)
+	{
+		fn.plain = useFunction;
+		context = NULL;
+		with_context = false;
+		return *this;
+	}
+
+	void set(ContextFunction useFunction, void * useContext)
+	{
+		fn.contextual = useFunction;
+		context = useContext;
+		with_context = (useFunction != NULL);
+	}
+
+	void clear() { *this = (Function)NULL; }
+
+	void * userContext() const { return context; }
+
+	explicit operator bool() const
+	{
+		return with_context ? (fn.contextual != NULL) : (fn.plain != NULL);
+	}
+
+	void operator()(EvoAll & link, Args... args) const
+	{
+		if (with_context)
+			fn.contextual(link, context, args...);
+		else
+			fn.plain(args...);
+	}
+
+private:
+	union {
+		Function plain;
+		ContextFunction contextual;
+	} fn;
+	void * context;
+	bool with_context;
+};
+
+typedef Callback<RemoteStarter::Event> RemoteStarterEventCallback;
+typedef Callback<OpenClose::Event> OpenCloseEventCallback;
+typedef Callback<Brake::Event> BrakeEventCallback;
+typedef Callback<Sensor::Event> SensorEventCallback;
+typedef Callback<Tach::Event> TachEventCallback;
+typedef Callback<DataLink::MessageCode> GenericMessageCallback;
+typedef Callback<DataLink::RequestCode, int> QueryResponseCallback;
+typedef Callback<ErrorMessage::Event, uint8_t> ErrorEventCallback;
+typedef Callback<DataLink::RequestCode, Request::Status, int> RequestCompletionCallback;
+typedef Callback<Sequence::Result, uint8_t> SequenceCompletionCallback;
+
 typedef struct CallbackContainerStruct {
 
 	// receive EvoLink::RemoteStarter::Events
-	RemoteStarterEventHandler 	remotestarter_event;
+	RemoteStarterEventCallback 	remotestarter_event;
 	// receive EvoLink::OpenClose::Events
-	OpenCloseEventHandler		openclose_event;
+	OpenCloseEventCallback		openclose_event;
 	// receive EvoLink::Brake::Events
-	BrakeEventHandler			brake_event;
+	BrakeEventCallback			brake_event;
 	// receive EvoLink::Sensor::Events
-	SensorEventHandler 			sensor_event;
+	SensorEventCallback 		sensor_event;
 	// receive EvoLink::Tach::Events
-	TachEventHandler 			tach_event;
+	TachEventCallback 			tach_event;
 	// receive EvoLink::DataLink::MessageCodes for messages not handled by above
-	GenericMessageHandler		message_received;
+	GenericMessageCallback		message_received;
 
 	// Request Data callback: function with signature
 	// void ... (EvoLink::DataLink::RequestCode request, int value)
 	// which will be called when temperature/input/tach/vss request
 	// responses are received
-	QueryResponseHandler		requested_data_received;
+	QueryResponseCallback		requested_data_received;
 
 	// receive EvoLink::ErrorMessage::Events
-	ErrorEventHandler			error_event;
-
-	CallbackContainerStruct() :
-		remotestarter_event(NULL),
-		openclose_event(NULL),
-		brake_event(NULL),
-		sensor_event(NULL),
-		tach_event(NULL),
-		message_received(NULL),
-		requested_data_received(NULL),
-		error_event(NULL)
+	ErrorEventCallback			error_event;
+
+} CallbackContainer;
+
+/*
+ * MessageMask -- a set of DataLink::MessageCodes, one bit per possible
+ * code, used to pick what an event bus subscriber gets (see
+ * EvoAll::subscribe()).  Calls may be chained:
+ *
+ *	EvoLink::MessageMask doors;
+ *	doors.add(EvoLink::DataLink::Door_Opened).add(EvoLink::DataLink::Door_Closed);
+ */
+typedef struct MessageMaskStruct {
+	uint8_t bits[32];
+
+	MessageMaskStruct() { none(); }
+
+	MessageMaskStruct & add(uint8_t code)
+	{
+		bits[code >> 3] |= (1 << (code & 0x07));
+		return *this;
+	}
+	MessageMaskStruct & remove(uint8_t code)
 	{
+		bits[code >> 3] &= ~(1 << (code & 0x07));
+		return *this;
+	}
+	bool has(uint8_t code) const
+	{
+		return (bits[code >> 3] & (1 << (code & 0x07))) != 0;
+	}
 
+	MessageMaskStruct & all()
+	{
+		for (uint8_t i=0; i < sizeof(bits); i++)
+			bits[i] = 0xff;
+		return *this;
+	}
+	MessageMaskStruct & none()
+	{
+		for (uint8_t i=0; i < sizeof(bits); i++)
+			bits[i] = 0;
+		return *this;
 	}
 
-} CallbackContainer;
+} MessageMask;
+
+/*
+ * Link statistics, kept when EVOLINK_STATISTICS_ENABLE is defined
+ * (see EvoAll::statistics()).
+ */
+namespace Stats {
+
+// events counted by family, i.e. by the callback they go to
+typedef enum StatsFamilyEnum {
+	RemoteStarter = 0,
+	OpenClose,
+	Brake,
+	Sensor,
+	Tach,
+	Generic,
+	Error,
+	NumFamilies
+} Family;
+
+// data requests with a latency histogram
+typedef enum StatsLatencyEnum {
+	TachLatency = 0,
+	VSSLatency,
+	TemperatureLatency,
+	InputLatency,
+	NumLatencies
+} Latency;
+
+}
+
+// request -> response latency buckets, upper bounds in ms (the last
+// one catches anything slower, up to the request timeout).
+#define EVOLINK_STATS_LATENCY_BUCKET_BOUNDS		{2, 5, 10, 20, 50, 100, 200}
+#define EVOLINK_STATS_LATENCY_BUCKETS			8
+
+/*
+ * Trace records, logged when EVOLINK_TRACE_ENABLE is defined (see
+ * EvoAll::drainTrace()).  Decisions with Trace::TX set are about bytes
+ * we sent, the others about bytes received.
+ */
+namespace Trace {
+
+typedef enum TraceDecisionEnum {
+	Dispatched = 0x01,	// supported event, to callbacks/custom handler
+	Response,			// response to the oldest data request in flight
+	Unsupported,		// unknown code (ErrorMessage::UnsupportedValue)
+	RequestTimeout,		// data: request code that went unanswered
+
+	TX = 0x80,
+	Sent,				// went out as soon as it was queued
+	AutoDelay,			// went out after waiting on the pacing delay
+	Suppressed,			// redundant on/off command, not sent
+	Expired,			// queued too long, dropped
+	WakeSkipped			// wakeUp() not needed, not sent
+} Decision;
+
+}
+
+typedef struct TraceRecordStruct {
+	uint16_t time_ms;	// low 16 bits of timeMs()
+	uint8_t data;		// the byte (message/request code)
+	uint8_t decision;	// Trace::Decision
+
+	bool transmitted() const { return (decision & Trace::TX) != 0;}
+} TraceRecord;
+
+/*
+ * Deferred events, when EVOLINK_EVENT_QUEUE_ENABLE is defined (see
+ * EvoAll::dispatchPending()).
+ */
+namespace Deferred {
+
+typedef enum DeferredKindEnum {
+	Message = 0,	// code: DataLink::MessageCode
+	Error,			// code: ErrorMessage::Event, value: its param
+	Response		// code: DataLink::RequestCode, value: the result
+} Kind;
+
+}
+
+typedef struct PendingEventStruct {
+	uint32_t time_ms;	// when it was received (or raised, for errors)
+	int value;
+	RequestHandle request; // Response: the request it completes
+	uint8_t code;
+	uint8_t kind;		// Deferred::Kind
+} PendingEvent;
+
+typedef struct EventQueueStatusStruct {
+	uint16_t pending;		// waiting for dispatchPending()
+	uint16_t high_water;	// most ever pending at once
+	uint16_t dropped;		// arrived while the queue was full
+	uint32_t max_wait_ms;	// longest an event waited to be dispatched
+} EventQueueStatus;
+
+typedef struct LinkStatisticsStruct {
+	uint32_t bytes_tx;			// everything, wake-ups included
+	uint32_t commands_tx;		// everything but wake-ups
+	uint32_t bytes_rx;
+	uint32_t events[Stats::NumFamilies]; // dispatched, incl. custom handlers
+	uint32_t unsupported_values; // ErrorMessage::UnsupportedValue
+	uint32_t request_timeouts;	// ErrorMessage::RequestTimeout
+	uint32_t rx_overruns;		// ErrorMessage::RxOverrun, as counted by the port
+	uint32_t pacing_ms;			// time commands were held back by pacing
+	uint16_t latency[Stats::NumLatencies][EVOLINK_STATS_LATENCY_BUCKETS];
+} LinkStatistics;
 
 }
 
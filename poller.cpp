@@ -0,0 +1,237 @@
+/*
+ * poller.cpp -- Telemetry poller for EvoLink, part of the
+ * cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "includes/poller.h"
+#include "includes/platform.h"
+
+namespace EvoLink {
+
+Poller::Poller(EvoAll & evoall) :
+		evo(evoall),
+		num_signals(0)
+{
+
+}
+
+Poller::PolledSignal * Poller::signalFor(DataLink::RequestCode code)
+{
+	for (uint8_t i=0; i < num_signals; i++)
+	{
+		if (signals[i].req == code)
+			return &(signals[i]);
+	}
+
+	return NULL;
+}
+
+bool Poller::setPeriod(DataLink::RequestCode code, uint32_t periodMs)
+{
+	switch (code)
+	{
+	case DataLink::Request_Tach:
+	case DataLink::Request_VSS:
+	case DataLink::Request_Temperature:
+	case DataLink::Request_Input:
+		break;
+	default:
+		// no response to poll for
+		return false;
+	}
+
+	PolledSignal * sig = signalFor(code);
+	if (! sig)
+	{
+		if (num_signals >= EVOLINK_POLLER_MAX_SIGNALS)
+			return false;
+
+		sig = &(signals[num_signals++]);
+		sig->req = (uint8_t)code;
+		sig->outstanding = RequestHandle();
+		sig->last_sample_time = 0;
+		sig->avg_interval_ms = 0;
+		sig->num_samples = 0;
+		sig->num_failures = 0;
+	}
+
+	sig->period_ms = periodMs;
+	sig->next_due = evo.clock().nowMs(); // first one right away
+	return true;
+}
+
+// the sample itself goes to requested_data_received, as usual
+void Poller::requestDone(EvoAll &, void * context,
+		DataLink::RequestCode request, Request::Status status, int)
+{
+	Poller * self = (Poller*)context;
+	PolledSignal * sig = self->signalFor(request);
+	if (sig && sig->outstanding)
+		self->collect(*sig, status);
+}
+
+void Poller::collect(PolledSignal & sig, Request::Status status)
+{
+	switch (status)
+	{
+	case Request::Complete:
+	{
+		uint32_t timeNow = evo.clock().nowMs();
+		if (sig.num_samples)
+		{
+			uint32_t interval = timeNow - sig.last_sample_time;
+			if (! sig.avg_interval_ms)
+			{
+				sig.avg_interval_ms = interval;
+			} else {
+				// moving average, over roughly the last 4 samples
+				sig.avg_interval_ms = sig.avg_interval_ms - (sig.avg_interval_ms / 4) + (interval / 4);
+			}
+		}
+		sig.last_sample_time = timeNow;
+		sig.num_samples++;
+		break;
+	}
+
+	default:
+		// timed out or dropped -- no sample
+		sig.num_failures++;
+		break;
+	}
+
+	sig.outstanding = RequestHandle();
+}
+
+void Poller::service()
+{
+	for (;;)
+	{
+		// don't let telemetry pile up in the command queue: if the link
+		// is busy, we'll be back.
+		if (evo.queuedRequests())
+			return;
+
+		// of those due, the one that's latest relative to its period goes
+		// first.  When the link is saturated, this slows every signal down
+		// in proportion, rather than starving the slow ones.
+		uint32_t timeNow = evo.clock().nowMs();
+		PolledSignal * next = NULL;
+		uint32_t nextLateness = 0;
+		for (uint8_t i=0; i < num_signals; i++)
+		{
+			PolledSignal & sig = signals[i];
+			if (! sig.period_ms || sig.outstanding)
+				continue;
+
+			int32_t late = (int32_t)(timeNow - sig.next_due);
+			if (late < 0)
+				continue; // not yet
+
+			// lateness, in 1/256ths of the period
+			uint32_t lateness = (((uint32_t)late << 8) / sig.period_ms) + 1;
+			if (lateness > nextLateness)
+			{
+				next = &sig;
+				nextLateness = lateness;
+			}
+		}
+
+		if (! next)
+			return; // nothing due
+
+		RequestHandle handle = evo.requestData((DataLink::RequestCode)next->req);
+		if (! handle)
+			return; // no room for it right now
+
+		// told when it's done, so the slot can't be reused under us
+		next->outstanding = handle;
+		evo.onComplete(handle, requestDone, this);
+		next->next_due += next->period_ms;
+		if ((int32_t)(timeNow - next->next_due) >= 0)
+		{
+			// fell behind, don't try to catch up
+			next->next_due = timeNow + next->period_ms;
+		}
+	}
+}
+
+uint32_t Poller::achievedRateMilliHz(DataLink::RequestCode code)
+{
+	PolledSignal * sig = signalFor(code);
+	if (! (sig && sig->avg_interval_ms))
+		return 0;
+
+	uint32_t interval = sig->avg_interval_ms;
+	uint32_t sinceLast = evo.clock().nowMs() - sig->last_sample_time;
+	if (sinceLast > interval)
+	{
+		// samples have stopped coming in as often
+		interval = sinceLast;
+	}
+
+	return 1000000UL / interval;
+}
+
+uint32_t Poller::samples(DataLink::RequestCode code)
+{
+	PolledSignal * sig = signalFor(code);
+	return sig ? sig->num_samples : 0;
+}
+
+uint32_t Poller::failures(DataLink::RequestCode code)
+{
+	PolledSignal * sig = signalFor(code);
+	return sig ? sig->num_failures : 0;
+}
+
+bool Poller::onTarget(uint8_t pct)
+{
+	for (uint8_t i=0; i < num_signals; i++)
+	{
+		PolledSignal & sig = signals[i];
+		if (! sig.period_ms)
+			continue;
+
+		uint32_t target = 1000000UL / sig.period_ms;
+		if ((achievedRateMilliHz((DataLink::RequestCode)sig.req) * 100) < (target * pct))
+			return false;
+	}
+
+	return true;
+}
+
+void Poller::resetStats()
+{
+	for (uint8_t i=0; i < num_signals; i++)
+	{
+		signals[i].avg_interval_ms = 0;
+		signals[i].num_samples = 0;
+		signals[i].num_failures = 0;
+	}
+}
+
+} /* namespace EvoLink */
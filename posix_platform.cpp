@@ -0,0 +1,74 @@
+/*
+ * posix_platform.cpp -- POSIX implementation for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "includes/config.h"
+#include "includes/platform.h"
+
+#ifdef PLATFORM_POSIX
+
+
+static void sleep_on_monotonic(uint32_t us)
+{
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	deadline.tv_sec += us / 1000000UL;
+	deadline.tv_nsec += (long)(us % 1000000UL) * 1000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	// absolute deadline, so being interrupted by a signal
+	// doesn't stretch the delay.
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+		;
+}
+
+uint32_t timeMs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	// wraps around, just like millis() does
+	return (uint32_t)(((uint64_t)now.tv_sec * 1000ULL) + (now.tv_nsec / 1000000L));
+}
+
+void delayMs(uint16_t ms)
+{
+	sleep_on_monotonic((uint32_t)ms * 1000UL);
+}
+
+void delayUs(uint16_t us)
+{
+	sleep_on_monotonic(us);
+}
+
+#endif
+
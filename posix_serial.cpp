@@ -0,0 +1,301 @@
+/*
+ * posix_serial.cpp -- POSIX SerialSetup for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "includes/serial.h"
+#include "includes/capture/session_capture.h"
+
+#ifdef PLATFORM_POSIX
+
+namespace EvoLink {
+
+// termios only knows the standard rates: anything else is refused,
+// rather than quietly running at some other speed.
+static bool baud_to_speed(uint32_t baud, speed_t & spd)
+{
+	switch (baud)
+	{
+	case 1200:
+		spd = B1200;
+		break;
+	case 2400:
+		spd = B2400;
+		break;
+	case 4800:
+		spd = B4800;
+		break;
+	case 9600:
+		spd = B9600;
+		break;
+	case 19200:
+		spd = B19200;
+		break;
+	case 38400:
+		spd = B38400;
+		break;
+	case 57600:
+		spd = B57600;
+		break;
+	case 115200:
+		spd = B115200;
+		break;
+#ifdef B230400
+	case 230400:
+		spd = B230400;
+		break;
+#endif
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+// the tty driver's count of bytes lost to hardware FIFO and receive
+// buffer overruns: termios itself has no way of telling.  Ptys, sockets
+// and the like don't keep these.
+static bool tty_overruns(int fd, uint32_t & count)
+{
+#if defined(__linux__) && defined(TIOCGICOUNT)
+	struct serial_icounter_struct icount;
+	if (ioctl(fd, TIOCGICOUNT, &icount) == 0)
+	{
+		count = (uint32_t)icount.overrun + (uint32_t)icount.buf_overrun;
+		return true;
+	}
+#endif
+	return false;
+}
+
+bool SerialConnection::setup(SerialSetup & params)
+{
+	speed_t spd;
+	if (! baud_to_speed(params.baud_rate, spd))
+		return false;
+
+	// let go of whatever we had
+	end();
+
+	// we always set up 8N1: start + 8 data + stop bits
+	char_time_us = ((1000000UL * 10) + params.baud_rate - 1) / params.baud_rate;
+
+	port = params.fd;
+	if (port < 0 && params.device)
+	{
+		port = open(params.device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+		owns_port = true;
+	}
+
+	if (port < 0)
+	{
+		end();
+		return false;
+	}
+
+	rx_overruns = 0;
+	tty_overruns(port, rx_overruns);
+
+	// we never want to block in read()/write()
+	int flags = fcntl(port, F_GETFL, 0);
+	if (flags >= 0)
+		fcntl(port, F_SETFL, flags | O_NONBLOCK);
+
+	if (! params.do_begin)
+		return true;
+
+	struct termios tio;
+	if (tcgetattr(port, &tio) != 0)
+	{
+		// not a tty (a socket, say) is fine: leave it as is
+		if (errno == ENOTTY || errno == EINVAL)
+			return true;
+
+		end();
+		return false;
+	}
+
+	// raw mode, 8N1, no flow control
+	cfmakeraw(&tio);
+	tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS);
+	tio.c_cflag |= (CS8 | CLOCAL | CREAD);
+	tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+
+	cfsetispeed(&tio, spd);
+	cfsetospeed(&tio, spd);
+
+	if (tcsetattr(port, TCSANOW, &tio) != 0)
+	{
+		end();
+		return false;
+	}
+
+	tcflush(port, TCIOFLUSH);
+	return true;
+}
+
+void SerialConnection::end()
+{
+	if (owns_port && port >= 0)
+		close(port);
+
+	port = EVOLINK_SERIALPORT_NONE;
+	owns_port = false;
+}
+
+size_t SerialConnection::write(uint8_t c)
+{
+	if (port < 0)
+		return 0;
+
+	for (uint8_t attempt = 0; attempt < 2; attempt++)
+	{
+		ssize_t r = ::write(port, &c, 1);
+		if (r == 1)
+		{
+			if (recorder)
+				recorder->record(true, c);
+			return 1;
+		}
+
+		if (r < 0 && errno == EINTR)
+			continue;
+
+		if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			// output buffer full -- give it a few ms to drain, then retry
+			struct pollfd pfd;
+			pfd.fd = port;
+			pfd.events = POLLOUT;
+			pfd.revents = 0;
+			poll(&pfd, 1, 10);
+			continue;
+		}
+
+		break;
+	}
+
+	return 0;
+}
+
+int SerialConnection::available()
+{
+	if (port < 0)
+		return 0;
+
+	int num = 0;
+	if (ioctl(port, FIONREAD, &num) < 0)
+		return 0;
+
+	return num;
+}
+
+int SerialConnection::read()
+{
+	if (port < 0)
+		return -1;
+
+	uint8_t c;
+	ssize_t r;
+	do {
+		r = ::read(port, &c, 1);
+	} while (r < 0 && errno == EINTR);
+
+	if (r != 1)
+		return -1;
+
+	if (recorder)
+		recorder->record(false, c);
+
+	return c;
+}
+
+size_t SerialConnection::readBytes(uint8_t * buf, size_t max)
+{
+	if (port < 0 || ! max)
+		return 0;
+
+	ssize_t r;
+	do {
+		r = ::read(port, buf, max);
+	} while (r < 0 && errno == EINTR);
+
+	if (r <= 0)
+		return 0;
+
+	if (recorder)
+		recorder->record(false, buf, (size_t)r);
+
+	return (size_t)r;
+}
+
+uint16_t SerialConnection::rxOverruns()
+{
+	uint32_t count;
+	if (port < 0 || ! tty_overruns(port, count))
+		return 0;
+
+	return (uint16_t)(count - rx_overruns);
+}
+
+bool SerialConnection::waitForData(uint32_t timeoutUs)
+{
+	if (port < 0)
+		return false;
+
+	struct pollfd pfd;
+	pfd.fd = port;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+#ifdef __linux__
+	// character times at higher baud rates are well under a ms
+	struct timespec ts;
+	ts.tv_sec = timeoutUs / 1000000UL;
+	ts.tv_nsec = (timeoutUs % 1000000UL) * 1000;
+	int r = ppoll(&pfd, 1, &ts, NULL);
+#else
+	int r = poll(&pfd, 1, (timeoutUs + 999) / 1000);
+#endif
+
+	if (r > 0 && ! (pfd.revents & POLLIN))
+	{
+		// hung up or in error: nothing will be coming, but don't spin
+		poll(NULL, 0, (timeoutUs + 999) / 1000);
+		return false;
+	}
+
+	return (r > 0);
+}
+
+} /* namespace EvoLink */
+
+
+#endif /* PLATFORM_POSIX */
+
@@ -0,0 +1,286 @@
+/*
+ * session_capture.cpp -- Session capture/replay for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "includes/capture/session_capture.h"
+
+#ifdef PLATFORM_POSIX
+
+#include <time.h>
+
+#define CAPTURE_TX_FLAG			0x80
+#define CAPTURE_DELAY_ESCAPE	0x7f
+
+namespace EvoLink {
+
+static void put_u32(uint8_t * buf, uint32_t v)
+{
+	for (uint8_t i=0; i < 4; i++)
+	{
+		buf[i] = (uint8_t)(v >> (8 * i));
+	}
+}
+
+static uint32_t get_u32(const uint8_t * buf)
+{
+	return ((uint32_t)buf[0]) | ((uint32_t)buf[1] << 8) |
+			((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/*
+ * SessionRecorder
+ */
+SessionRecorder::SessionRecorder() :
+		clock_src(&SystemClock),
+		file(NULL),
+		last_time(0),
+		num_records(0)
+{
+
+}
+
+SessionRecorder::~SessionRecorder()
+{
+	close();
+}
+
+bool SessionRecorder::open(const char * path, uint32_t baud, uint8_t bitsPerChar)
+{
+	close();
+
+	file = fopen(path, "wb");
+	if (! file)
+		return false;
+
+	uint8_t header[EVOLINK_CAPTURE_HEADER_SIZE] = {'E', 'V', 'C', 'P',
+			EVOLINK_CAPTURE_VERSION, bitsPerChar, 0, 0};
+	put_u32(&(header[8]), baud);
+	put_u32(&(header[12]), (uint32_t)time(NULL));
+
+	if (fwrite(header, sizeof(header), 1, file) != 1)
+	{
+		close();
+		return false;
+	}
+
+	last_time = clock_src->nowMs();
+	num_records = 0;
+	return true;
+}
+
+void SessionRecorder::close()
+{
+	if (! file)
+		return;
+
+	fclose(file);
+	file = NULL;
+}
+
+void SessionRecorder::record(bool transmitted, uint8_t byte)
+{
+	if (! file)
+		return;
+
+	uint32_t now = clock_src->nowMs();
+	uint32_t delay = now - last_time;
+	last_time = now;
+
+	uint8_t rec[6];
+	uint8_t len = 0;
+	uint8_t dirFlag = transmitted ? CAPTURE_TX_FLAG : 0;
+	if (delay < CAPTURE_DELAY_ESCAPE)
+	{
+		rec[len++] = dirFlag | (uint8_t)delay;
+	} else {
+		rec[len++] = dirFlag | CAPTURE_DELAY_ESCAPE;
+		put_u32(&(rec[len]), delay);
+		len += 4;
+	}
+	rec[len++] = byte;
+
+	// stdio buffers it, so this is cheap
+	fwrite(rec, len, 1, file);
+	num_records++;
+}
+
+void SessionRecorder::record(bool transmitted, const uint8_t * bytes, size_t len)
+{
+	for (size_t i=0; i < len; i++)
+	{
+		record(transmitted, bytes[i]);
+	}
+}
+
+/*
+ * SessionReplay
+ */
+SessionReplay::SessionReplay() :
+		file(NULL),
+		baud_rate(0),
+		bits_per_char(0),
+		start_time(0),
+		elapsed(0),
+		virtual_clock()
+{
+
+}
+
+SessionReplay::~SessionReplay()
+{
+	close();
+}
+
+bool SessionReplay::open(const char * path)
+{
+	close();
+
+	file = fopen(path, "rb");
+	if (! file)
+		return false;
+
+	uint8_t header[EVOLINK_CAPTURE_HEADER_SIZE];
+	if (fread(header, sizeof(header), 1, file) != 1 ||
+			header[0] != 'E' || header[1] != 'V' || header[2] != 'C' || header[3] != 'P' ||
+			header[4] != EVOLINK_CAPTURE_VERSION)
+	{
+		// not one of ours
+		close();
+		return false;
+	}
+
+	bits_per_char = header[5];
+	baud_rate = get_u32(&(header[8]));
+	start_time = get_u32(&(header[12]));
+	elapsed = 0;
+	return true;
+}
+
+void SessionReplay::close()
+{
+	if (! file)
+		return;
+
+	fclose(file);
+	file = NULL;
+}
+
+bool SessionReplay::next(CaptureRecord & rec)
+{
+	if (! file)
+		return false;
+
+	int tag = fgetc(file);
+	if (tag == EOF)
+		return false;
+
+	uint32_t delay = tag & CAPTURE_DELAY_ESCAPE;
+	if (delay == CAPTURE_DELAY_ESCAPE)
+	{
+		uint8_t buf[4];
+		if (fread(buf, sizeof(buf), 1, file) != 1)
+			return false;
+		delay = get_u32(buf);
+	}
+
+	int data = fgetc(file);
+	if (data == EOF)
+		return false;
+
+	elapsed += delay;
+	rec.time_ms = elapsed;
+	rec.data = (uint8_t)data;
+	rec.transmitted = (tag & CAPTURE_TX_FLAG) != 0;
+	return true;
+}
+
+uint32_t SessionReplay::run(EvoAll & link, Pace pace)
+{
+	uint32_t numReplayed = 0;
+
+	// replay time == base + time in capture
+	Clock & realClock = link.clock();
+	uint32_t base = realClock.nowMs() - elapsed;
+	if (pace == VirtualTime)
+	{
+		virtual_clock.set(realClock.nowMs());
+		link.setClock(virtual_clock);
+	}
+
+	CaptureRecord rec;
+	while (next(rec))
+	{
+		uint32_t when = base + rec.time_ms;
+		if (pace == VirtualTime)
+		{
+			// step through whatever falls due in between, so
+			// timeouts & co. happen when they would have
+			uint32_t deadline;
+			uint8_t idle = 0;
+			while (link.nextDeadline(deadline) && ((int32_t)(deadline - when) < 0) && idle < 2)
+			{
+				if ((int32_t)(deadline - virtual_clock.nowMs()) > 0)
+				{
+					virtual_clock.set(deadline);
+					idle = 0;
+				} else {
+					idle++; // due now, and servicing didn't change that
+				}
+				link.serviceDeadlines();
+			}
+
+			if ((int32_t)(when - virtual_clock.nowMs()) > 0)
+				virtual_clock.set(when);
+		} else {
+			int32_t remaining;
+			while ((remaining = (int32_t)(when - realClock.nowMs())) > 0)
+			{
+				link.serviceDeadlines();
+				realClock.delayMs(remaining > 10 ? 10 : remaining);
+			}
+		}
+
+		link.serviceDeadlines();
+		if (rec.transmitted)
+		{
+			link.noteTransmitted((DataLink::RequestCode)rec.data);
+		} else {
+			link.parseMessage(rec.data);
+		}
+		numReplayed++;
+	}
+
+	if (pace == VirtualTime)
+		link.setClock(realClock);
+
+	return numReplayed;
+}
+
+} /* namespace EvoLink */
+
+#endif /* PLATFORM_POSIX */
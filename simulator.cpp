@@ -0,0 +1,478 @@
+/*
+ * simulator.cpp -- Host-side EVO-All simulator for EvoLink,
+ * part of the cross-platform EVO-All interface library.
+ *
+ * Copyright (C) 2014 Pat Deegan. All Rights Reserved.
+ *
+ * http://flyingcarsandstuff.com/projects/EvoLink
+ *
+ * Please let me know if you use EvoLink in your projects, and
+ * provide a URL if you'd like me to link to it from the EvoLink
+ * home.
+ *
+ * Released under the GPL v3, dual licensing available.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "includes/sim/simulator.h"
+
+#ifdef PLATFORM_POSIX
+
+// from EvoAllSimulator: horn_on_time_multiplier
+#define SIMULATOR_HORN_TIME_MULTIPLIER		3
+
+namespace EvoLink {
+
+typedef struct SimRandomEventStruct {
+	uint8_t msgcode;
+	uint8_t family;
+} SimRandomEvent;
+
+static const SimRandomEvent random_events[] = {
+	{DataLink::RemoteStarter_Disarm,		Simulator::RemoteStarterEvents},
+	{DataLink::RemoteStarter_Arm,			Simulator::RemoteStarterEvents},
+	{DataLink::RemoteStarter_On,			Simulator::RemoteStarterEvents},
+	{DataLink::RemoteStarter_Off,			Simulator::RemoteStarterEvents},
+	{DataLink::RemoteStarter_UnlockDisarm,	Simulator::RemoteStarterEvents},
+	{DataLink::RemoteStarter_LockArm,		Simulator::RemoteStarterEvents},
+
+	{DataLink::Door_Opened,					Simulator::OpenCloseEvents},
+	{DataLink::Door_Closed,					Simulator::OpenCloseEvents},
+	{DataLink::Hood_Opened,					Simulator::OpenCloseEvents},
+	{DataLink::Hood_Closed,					Simulator::OpenCloseEvents},
+	{DataLink::Trunk_Opened,				Simulator::OpenCloseEvents},
+	{DataLink::Trunk_Closed,				Simulator::OpenCloseEvents},
+
+	{DataLink::HandBrake_On,				Simulator::BrakeEvents},
+	{DataLink::HandBrake_Off,				Simulator::BrakeEvents},
+	{DataLink::Brake_On,					Simulator::BrakeEvents},
+	{DataLink::Brake_Off,					Simulator::BrakeEvents},
+
+	{DataLink::VSS_Over_15MPH,				Simulator::SensorEvents},
+	{DataLink::ShockSensor_Trigger,			Simulator::SensorEvents},
+	{DataLink::AlarmSensor_PreWarn,			Simulator::SensorEvents},
+	{DataLink::TiltSensor_Trigger,			Simulator::SensorEvents},
+
+	{DataLink::Tach_On,						Simulator::TachEvents},
+	{DataLink::Tach_Off,					Simulator::TachEvents},
+	{DataLink::Tach_OverRev,				Simulator::TachEvents},
+
+	{DataLink::CarKey_In_On,				Simulator::MiscEvents},
+	{DataLink::CarKey_In_Off,				Simulator::MiscEvents},
+	{DataLink::RemoteProgramming_Enable,	Simulator::MiscEvents},
+	{DataLink::RemoteProgramming_Disable,	Simulator::MiscEvents},
+};
+
+#define SIM_NUM_RANDOM_EVENTS	(sizeof(random_events) / sizeof(random_events[0]))
+
+Simulator::Simulator(uint32_t seedVal) :
+		rand_state(1),
+		wake_timeout_ms(SIMULATOR_WAKE_TIMEOUT_MS),
+		resp_delay_min(SIMULATOR_RESPONSE_DELAY_MS),
+		resp_delay_max(SIMULATOR_RESPONSE_DELAY_MS),
+		min_request_gap_ms(SIMULATOR_MIN_REQUEST_GAP_MS),
+		event_families(NoEvents),
+		event_interval_ms(SIMULATOR_RANDOM_EVENT_INTERVAL_MS),
+		consistent_events(true),
+		input_status(0),
+		alarm_on(false),
+		horn_on(false),
+		horn_off_time(0),
+		ever_woken(false),
+		last_req_time(0),
+		last_event_time(0),
+		num_pending(0),
+		out_head(0),
+		out_count(0),
+		num_handled(0),
+		num_rejected(0),
+		num_dropped(0)
+{
+	seed(seedVal);
+}
+
+void Simulator::seed(uint32_t seedVal)
+{
+	// xorshift can't start from 0
+	rand_state = seedVal ? seedVal : 0x2545f491;
+}
+
+uint32_t Simulator::random()
+{
+	// xorshift32
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return rand_state;
+}
+
+void Simulator::setResponseDelayMs(uint16_t minMs, uint16_t maxMs)
+{
+	resp_delay_min = minMs;
+	resp_delay_max = (maxMs < minMs) ? minMs : maxMs;
+}
+
+void Simulator::setRandomEvents(uint8_t families, uint16_t intervalMs)
+{
+	event_families = families;
+	event_interval_ms = intervalMs;
+}
+
+void Simulator::emit(uint8_t code)
+{
+	if (out_count >= SIMULATOR_OUTPUT_BUFFER_SIZE)
+	{
+		// driver isn't keeping up
+		num_dropped++;
+		return;
+	}
+
+	out_buf[(out_head + out_count) % SIMULATOR_OUTPUT_BUFFER_SIZE] = code;
+	out_count++;
+}
+
+int Simulator::read()
+{
+	if (! out_count)
+		return -1;
+
+	uint8_t b = out_buf[out_head];
+	out_head = (out_head + 1) % SIMULATOR_OUTPUT_BUFFER_SIZE;
+	out_count--;
+	return b;
+}
+
+void Simulator::receive(uint8_t reqCode, uint32_t nowMs)
+{
+	if (reqCode == REQ_WAKEUP)
+	{
+		// just a wakeup call...
+		ever_woken = true;
+		last_req_time = nowMs;
+		return;
+	}
+
+	if (! ever_woken || (int32_t)(nowMs - last_req_time) > (int32_t)wake_timeout_ms)
+	{
+		// you need to wake me up!
+		num_rejected++;
+		return;
+	}
+
+	// too soon after the last: it gets to this one when it can
+	if ((int32_t)(last_req_time + min_request_gap_ms - nowMs) > 0)
+		nowMs = last_req_time + min_request_gap_ms;
+
+	// ok, timing is good...
+	last_req_time = nowMs;
+	num_handled++;
+
+	uint16_t hornOnTime = 0;
+	switch (reqCode)
+	{
+	case REQ_REQUEST_INPUT:
+	case REQ_PING:
+	case REQ_PONG:
+		// answered right away
+		scheduleResponse(reqCode, nowMs);
+		break;
+
+	case REQ_REQUEST_TACH:
+	case REQ_REQUEST_VSS:
+	case REQ_REQUEST_TEMPERATURE:
+	{
+		uint16_t delay = resp_delay_min;
+		if (resp_delay_max > resp_delay_min)
+			delay += random() % (resp_delay_max - resp_delay_min + 1);
+		scheduleResponse(reqCode, nowMs + delay);
+		break;
+	}
+
+	case REQ_ALARM_ON:
+		alarm_on = true;
+		break;
+	case REQ_ALARM_OFF:
+		alarm_on = false;
+		break;
+
+	case REQ_HORN_ON:
+		horn_on = true;
+		horn_off_time = 0;
+		break;
+	case REQ_HORN_OFF:
+		horn_on = false;
+		horn_off_time = 0;
+		break;
+	case REQ_HORN_ON_250MS:
+		hornOnTime = 250;
+		break;
+	case REQ_HORN_ON_50MS:
+		hornOnTime = 50;
+		break;
+	case REQ_HORN_ON_15MS:
+		hornOnTime = 15;
+		break;
+
+	default:
+		// don't care...
+		break;
+	}
+
+	if (hornOnTime)
+	{
+		horn_on = true;
+		horn_off_time = nowMs + (hornOnTime * SIMULATOR_HORN_TIME_MULTIPLIER);
+		if (! horn_off_time)
+			horn_off_time = 1;
+	}
+}
+
+bool Simulator::hornOn(uint32_t nowMs)
+{
+	if (horn_on && horn_off_time && (int32_t)(nowMs - horn_off_time) >= 0)
+	{
+		horn_on = false;
+		horn_off_time = 0;
+	}
+
+	return horn_on;
+}
+
+void Simulator::scheduleResponse(uint8_t reqCode, uint32_t due)
+{
+	if (num_pending >= SIMULATOR_MAX_PENDING_RESPONSES)
+		return; // swamped: lost, as far as the driver can tell
+
+	// keep them in the order they'll go out, a quick answer
+	// overtaking any slow one still in the works
+	uint8_t i = num_pending;
+	while (i && (int32_t)(due - pending[i - 1].due) < 0)
+	{
+		pending[i] = pending[i - 1];
+		i--;
+	}
+
+	pending[i].req = reqCode;
+	pending[i].due = due;
+	num_pending++;
+}
+
+void Simulator::respond(uint8_t reqCode)
+{
+	switch (reqCode)
+	{
+	case REQ_REQUEST_INPUT:
+		emit(input_status.asByte());
+		break;
+	case REQ_PING:
+		emit(MSG_PING);
+		break;
+	case REQ_PONG:
+		emit(MSG_PONG);
+		break;
+	case REQ_REQUEST_TACH:
+		emit(random() % 0x6c);
+		break;
+	case REQ_REQUEST_VSS:
+		emit(random() % 200);
+		break;
+	case REQ_REQUEST_TEMPERATURE:
+		emit(168 + (random() % 100) - 20); // goes from -20 to 80
+		break;
+	default:
+		break;
+	}
+}
+
+void Simulator::service(uint32_t nowMs)
+{
+	while (num_pending && (int32_t)(nowMs - pending[0].due) >= 0)
+	{
+		uint8_t req = pending[0].req;
+		num_pending--;
+		for (uint8_t i=0; i < num_pending; i++)
+		{
+			pending[i] = pending[i + 1];
+		}
+
+		respond(req);
+	}
+
+	if (event_families && (nowMs - last_event_time) >= event_interval_ms)
+	{
+		last_event_time = nowMs;
+		sendRandomEvent();
+	}
+}
+
+void Simulator::serviceFd(int fd, uint32_t nowMs)
+{
+	uint8_t buf[16];
+	ssize_t numRead;
+	while ((numRead = ::read(fd, buf, sizeof(buf))) > 0)
+	{
+		for (ssize_t i=0; i < numRead; i++)
+		{
+			receive(buf[i], nowMs);
+		}
+	}
+
+	service(nowMs);
+
+	while (out_count)
+	{
+		uint8_t b = out_buf[out_head];
+		if (::write(fd, &b, 1) != 1)
+			return; // try again next time
+
+		read();
+	}
+}
+
+bool Simulator::applyEvent(uint8_t msgcode, bool mustChange)
+{
+	// keep track of a few of these... returns false if mustChange and
+	// it wouldn't change anything.
+	State::OpenClose * openClose = NULL;
+	State::SetTo * onOff = NULL;
+	bool active = false;
+	switch (msgcode)
+	{
+	case MSG_DOOR_OPENED:
+		active = true;
+		/* fall-through */
+	case MSG_DOOR_CLOSED:
+		openClose = &(input_status.door);
+		break;
+
+	case MSG_HOOD_OPENED:
+		active = true;
+		/* fall-through */
+	case MSG_HOOD_CLOSED:
+		openClose = &(input_status.hood);
+		break;
+
+	case MSG_TRUNK_OPENED:
+		active = true;
+		/* fall-through */
+	case MSG_TRUNK_CLOSED:
+		openClose = &(input_status.trunk);
+		break;
+
+	case MSG_HANDBRAKE_ON:
+		active = true;
+		/* fall-through */
+	case MSG_HANDBRAKE_OFF:
+		onOff = &(input_status.hand_brake);
+		break;
+
+	case MSG_BRAKE_ON:
+		active = true;
+		/* fall-through */
+	case MSG_BRAKE_OFF:
+		onOff = &(input_status.brake);
+		break;
+
+	case MSG_TACH_ON:
+		active = true;
+		/* fall-through */
+	case MSG_TACH_OFF:
+		onOff = &(input_status.tach);
+		break;
+
+	default:
+		// stateless
+		return true;
+	}
+
+	if (openClose)
+	{
+		State::OpenClose st = active ? State::Open : State::Closed;
+		if (mustChange && *openClose == st)
+			return false;
+		*openClose = st;
+	} else {
+		State::SetTo st = active ? State::On : State::Off;
+		if (mustChange && *onOff == st)
+			return false;
+		*onOff = st;
+	}
+
+	return true;
+}
+
+bool Simulator::sendRandomEvent(bool force)
+{
+	if (! event_families && ! force)
+		return false;
+
+	uint8_t families = event_families ? event_families : (uint8_t)AllEvents;
+
+	// a bounded number of tries, in case the families on offer are
+	// all stuck (can't happen with on/off pairs, but still)
+	for (uint8_t attempt=0; attempt < 32; attempt++)
+	{
+		const SimRandomEvent & evt = random_events[random() % SIM_NUM_RANDOM_EVENTS];
+		if (! (evt.family & families))
+			continue;
+
+		if (applyEvent(evt.msgcode, consistent_events))
+		{
+			emit(evt.msgcode);
+			return true;
+		}
+
+		if (! force)
+			return false;
+	}
+
+	return false;
+}
+
+void Simulator::setInput(Input::Field field, bool active)
+{
+	uint8_t msgcode;
+	switch (field)
+	{
+	case Input::Door:
+		msgcode = active ? MSG_DOOR_OPENED : MSG_DOOR_CLOSED;
+		break;
+	case Input::Hood:
+		msgcode = active ? MSG_HOOD_OPENED : MSG_HOOD_CLOSED;
+		break;
+	case Input::Trunk:
+		msgcode = active ? MSG_TRUNK_OPENED : MSG_TRUNK_CLOSED;
+		break;
+	case Input::Tach:
+		msgcode = active ? MSG_TACH_ON : MSG_TACH_OFF;
+		break;
+	case Input::HandBrake:
+		msgcode = active ? MSG_HANDBRAKE_ON : MSG_HANDBRAKE_OFF;
+		break;
+	case Input::Brake:
+		msgcode = active ? MSG_BRAKE_ON : MSG_BRAKE_OFF;
+		break;
+	default:
+		return;
+	}
+
+	if (applyEvent(msgcode, true))
+		emit(msgcode);
+}
+
+} /* namespace EvoLink */
+
+#endif /* PLATFORM_POSIX */